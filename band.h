@@ -0,0 +1,195 @@
+/* guard band capture, see -guard.
+
+   Each view grabs a band of guard pixels around its source area and
+   keeps it. While the source area stays in the band it is taken from
+   there without a grab, only what XDamage reports as changed in the
+   band is grabbed again. When the source area leaves the band a new
+   band is made around it: what the old and the new band have in
+   common is copied over and only the strips that came in are grabbed.
+   Without XDamage the band could be out of date, so it needs that. */
+
+int guard = 0;						/* -guard, 0 if there is no band */
+
+#ifdef XSHM
+XShmSegmentInfo strip_shminfo;		/* strips are grabbed here first */
+size_t strip_size = 0;
+#endif
+
+/* make image k of b w x h */
+void
+band_image(struct band *b, int k, int w, int h) {
+	XImage *image = b->image[k];
+
+	if(image && image->width == w && image->height == h)
+		return;
+
+	if(image) {
+#ifdef XSHM
+		if(!use_shm)
+#endif
+		free(image->data);
+		image->data = NULL;
+		XDestroyImage(image);
+	}
+
+#ifdef XSHM
+	if(use_shm) {
+		b->image[k] = shm_image(dpy, &b->shminfo[k], &b->size[k], w, h);
+		return;
+	}
+#endif
+	b->image[k] = plain_image(w, h);
+}
+
+/* grab x0, y0 .. x1, y1 of the screen into the band */
+void
+band_grab(struct band *b, int x0, int y0, int x1, int y1) {
+	XImage *image = b->image[b->cur];
+#ifdef XSHM
+	XImage *strip;
+	int bpp = image->bits_per_pixel / 8;
+	int y;
+#endif
+
+	if(x0 >= x1 || y0 >= y1)
+		return;
+
+#ifdef XSHM
+	if(use_shm) {
+		if(x0 == b->x0 && y0 == b->y0 && x1 == b->x1 && y1 == b->y1) {
+			XShmGetImage(dpy, RootWindowOfScreen(scr), image,
+				x0, y0, AllPlanes);
+			return;
+		}
+
+		/* XShmGetImage fills a whole image */
+		strip = shm_image(dpy, &strip_shminfo, &strip_size,
+			x1 - x0, y1 - y0);
+		XShmGetImage(dpy, RootWindowOfScreen(scr), strip,
+			x0, y0, AllPlanes);
+		for(y = 0; y < y1 - y0; y++)
+			memcpy(image->data + (y0 - b->y0 + y) * image->bytes_per_line +
+				(x0 - b->x0) * bpp,
+				strip->data + y * strip->bytes_per_line,
+				(x1 - x0) * bpp);
+		strip->data = NULL;
+		XDestroyImage(strip);
+		return;
+	}
+#endif
+
+	XGetSubImage(dpy, RootWindowOfScreen(scr),
+		x0, y0, x1 - x0, y1 - y0, AllPlanes,
+		ZPixmap, image, x0 - b->x0, y0 - b->y0);
+}
+
+/* add the damage fetched which falls in the band of v */
+void
+band_damaged(struct view *v) {
+	struct band *b = &v->band;
+	XRectangle *r = damage_rects;
+	int i, x0, y0, x1, y1;
+
+	for(i = 0; i < ndamage_rects; i++) {
+		x0 = r[i].x > b->x0 ? r[i].x : b->x0;
+		y0 = r[i].y > b->y0 ? r[i].y : b->y0;
+		x1 = r[i].x + r[i].width < b->x1 ? r[i].x + r[i].width : b->x1;
+		y1 = r[i].y + r[i].height < b->y1 ? r[i].y + r[i].height : b->y1;
+		if(x0 >= x1 || y0 >= y1)
+			continue;
+
+		if(b->dx1 <= b->dx0) {
+			b->dx0 = x0;
+			b->dy0 = y0;
+			b->dx1 = x1;
+			b->dy1 = y1;
+			continue;
+		}
+		if(x0 < b->dx0)
+			b->dx0 = x0;
+		if(y0 < b->dy0)
+			b->dy0 = y0;
+		if(x1 > b->dx1)
+			b->dx1 = x1;
+		if(y1 > b->dy1)
+			b->dy1 = y1;
+	}
+}
+
+/* bring the band of v up to date for its source area
+   and make its SRC the part of the band it shows */
+void
+band_source(struct view *v) {
+	struct band *b = &v->band;
+	XImage *old, *new;
+	int x0 = v->xgrab, y0 = v->ygrab;
+	int x1 = x0 + v->width[SRC], y1 = y0 + v->height[SRC];
+	int nx0, ny0, nx1, ny1;				/* the new band */
+	int ox0, oy0, ox1, oy1;				/* what it has of the old one */
+	int bpp, y;
+
+	if(b->x1 == b->x0 ||
+	   x0 < b->x0 || y0 < b->y0 || x1 > b->x1 || y1 > b->y1) {
+		nx0 = x0 - guard > 0 ? x0 - guard : 0;
+		ny0 = y0 - guard > 0 ? y0 - guard : 0;
+		nx1 = x1 + guard < WidthOfScreen(scr) ? x1 + guard : WidthOfScreen(scr);
+		ny1 = y1 + guard < HeightOfScreen(scr) ? y1 + guard : HeightOfScreen(scr);
+
+		ox0 = nx0 > b->x0 ? nx0 : b->x0;
+		oy0 = ny0 > b->y0 ? ny0 : b->y0;
+		ox1 = nx1 < b->x1 ? nx1 : b->x1;
+		oy1 = ny1 < b->y1 ? ny1 : b->y1;
+
+		old = b->image[b->cur];
+		b->cur = !b->cur;
+		band_image(b, b->cur, nx1 - nx0, ny1 - ny0);
+		new = b->image[b->cur];
+
+		if(b->x1 == b->x0 || ox0 >= ox1 || oy0 >= oy1) {
+			b->x0 = nx0;
+			b->y0 = ny0;
+			b->x1 = nx1;
+			b->y1 = ny1;
+			b->dx1 = b->dx0;			/* all of it is grabbed */
+			band_grab(b, nx0, ny0, nx1, ny1);
+		}
+		else {
+			bpp = new->bits_per_pixel / 8;
+			for(y = oy0; y < oy1; y++)
+				memcpy(new->data + (y - ny0) * new->bytes_per_line +
+					(ox0 - nx0) * bpp,
+					old->data + (y - b->y0) * old->bytes_per_line +
+					(ox0 - b->x0) * bpp,
+					(ox1 - ox0) * bpp);
+
+			b->x0 = nx0;
+			b->y0 = ny0;
+			b->x1 = nx1;
+			b->y1 = ny1;
+			band_grab(b, nx0, ny0, nx1, oy0);	/* above */
+			band_grab(b, nx0, oy1, nx1, ny1);	/* below */
+			band_grab(b, nx0, oy0, ox0, oy1);	/* left */
+			band_grab(b, ox1, oy0, nx1, oy1);	/* right */
+		}
+	}
+
+	/* the damage, as far as it is still in the band */
+	if(b->dx1 > b->dx0) {
+		band_grab(b,
+			b->dx0 > b->x0 ? b->dx0 : b->x0,
+			b->dy0 > b->y0 ? b->dy0 : b->y0,
+			b->dx1 < b->x1 ? b->dx1 : b->x1,
+			b->dy1 < b->y1 ? b->dy1 : b->y1);
+		b->dx1 = b->dx0;
+	}
+
+	new = b->image[b->cur];
+	v->part = *new;
+	v->part.width = v->width[SRC];
+	v->part.height = v->height[SRC];
+	v->part.data += (y0 - b->y0) * new->bytes_per_line +
+		(x0 - b->x0) * new->bits_per_pixel / 8;
+	v->ximage[SRC] = &v->part;
+	v->src_x = x0;
+	v->src_y = y0;
+}
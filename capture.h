@@ -0,0 +1,227 @@
+/* pipelined capture, enabled with -pipeline.
+
+   A thread with its own connection to the server grabs the source
+   area into a ring of NRING SHM images, while main() scales and puts
+   the newest complete one. So the grab of the next frame overlaps
+   with the scaling and the put of this one. Frames main() did not
+   take in time are dropped, a later one replaces them.
+
+   The thread keeps grabbing every frame interval for as long as the
+   source area changes, and stops when it grabs what it already has
+   until main() asks again. Every frame gets a sequence number and
+   the time its grab started: the time from there to the flush of
+   the put is the "latency" stage of -stats, the frames skipped in
+   the sequence are counted as dropped. */
+
+#define NRING		3				/* source images in the ring */
+
+#define SLOT_FREE	0				/* can be grabbed into */
+#define SLOT_GRAB	1				/* the thread grabs into it */
+#define SLOT_READY	2				/* a complete frame */
+#define SLOT_SHOWN	3				/* main() scales from it */
+
+struct slot {
+	XImage *image;
+	XShmSegmentInfo shminfo;
+	size_t size;					/* of its segment, see shm_image() */
+	int width, height;				/* of image, 0 when there is none */
+	int xgrab, ygrab;				/* where it was grabbed */
+	unsigned long seq;				/* sequence number of the frame */
+	long long time;					/* when the grab started, usec */
+	int state;
+} ring[NRING];
+
+int pipeline = False;				/* -pipeline */
+Display *capture_dpy;				/* connection of the capture thread */
+int capture_fd;						/* eventfd, written for new frames */
+
+/* all below is shared with the capture thread */
+pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+int capture_on = False;				/* the thread should keep grabbing */
+int capture_force = False;			/* ... and send the next frame anyway */
+int capture_x, capture_y;			/* what to grab */
+int capture_w, capture_h;
+long long capture_interval;			/* time between grabs */
+unsigned long capture_seq = 0;		/* of the last frame sent */
+
+int shown_slot = -1;				/* the slot in ximage[SRC] */
+unsigned long shown_seq = 0;		/* of the frame in it */
+
+/* (re)make the image of a slot, on the connection of the thread */
+void
+ring_image(struct slot *s, int w, int h) {
+	if(s->image) {
+		s->image->data = NULL;
+		XDestroyImage(s->image);
+	}
+
+	s->image = shm_image(capture_dpy, &s->shminfo, &s->size, w, h);
+	s->width = w;
+	s->height = h;
+}
+
+void *
+capture_thread(void *arg) {
+	Window root = DefaultRootWindow(capture_dpy);
+	struct slot *s, *last = NULL;
+	long long start, wait;
+	uint64_t one = 1;
+	int i, x, y, w, h, force, same;
+
+	pthread_mutex_lock(&ring_lock);
+	for(;;) {
+		while(!capture_on)
+			pthread_cond_wait(&capture_cond, &ring_lock);
+
+		x = capture_x;
+		y = capture_y;
+		w = capture_w;
+		h = capture_h;
+		force = capture_force;
+		capture_force = False;
+
+		/* a free slot, or the oldest frame main() did not take.
+		   main() holds at most one and we never take the last
+		   one we sent, so there always is one */
+		s = NULL;
+		for(i = 0; i < NRING && !s; i++)
+			if(ring[i].state == SLOT_FREE)
+				s = &ring[i];
+		for(i = 0; i < NRING && !s; i++)
+			if(ring[i].state == SLOT_READY && &ring[i] != last)
+				s = &ring[i];
+		s->state = SLOT_GRAB;
+		pthread_mutex_unlock(&ring_lock);
+
+		start = now_usec();
+		if(s->width != w || s->height != h)
+			ring_image(s, w, h);
+		XShmGetImage(capture_dpy, root, s->image, x, y, AllPlanes);
+
+		/* the last frame is READY or SHOWN, nobody writes it */
+		same = !force && last && last->width == w && last->height == h &&
+			last->xgrab == x && last->ygrab == y &&
+			!memcmp(last->image->data, s->image->data,
+				s->image->bytes_per_line * h);
+
+		pthread_mutex_lock(&ring_lock);
+		if(same) {
+			s->state = SLOT_FREE;
+			if(!capture_force)
+				capture_on = False;
+			continue;
+		}
+
+		s->xgrab = x;
+		s->ygrab = y;
+		s->seq = ++capture_seq;
+		s->time = start;
+		s->state = SLOT_READY;
+		last = s;
+		wait = start + capture_interval - now_usec();
+		pthread_mutex_unlock(&ring_lock);
+
+		if(write(capture_fd, &one, sizeof(one)) < 0)
+			perror("write");
+
+		if(wait > 0)
+			usleep(wait);
+
+		pthread_mutex_lock(&ring_lock);
+	}
+	return NULL;
+}
+
+/* open the connection of the capture thread and start it */
+void
+init_capture(void) {
+	pthread_t thread;
+
+	if(!(capture_dpy = XOpenDisplay(DisplayString(dpy)))) {
+		perror("Cannot open display");
+		exit(-1);
+	}
+
+	capture_fd = eventfd(0, EFD_NONBLOCK);
+	if(capture_fd < 0) {
+		perror("eventfd");
+		exit(-1);
+	}
+
+	if(pthread_create(&thread, NULL, capture_thread, NULL)) {
+		perror("pthread_create");
+		exit(-1);
+	}
+	pthread_detach(thread);
+}
+
+/* have the thread grab the source area from now on. With force
+   the next frame is sent even if nothing changed */
+void
+start_capture(int force) {
+	pthread_mutex_lock(&ring_lock);
+	capture_x = xgrab;
+	capture_y = ygrab;
+	capture_w = width[SRC];
+	capture_h = height[SRC];
+	capture_interval = frame_interval();
+	capture_force = capture_force || force;
+	capture_on = True;
+	pthread_cond_signal(&capture_cond);
+	pthread_mutex_unlock(&ring_lock);
+}
+
+/* take the newest frame into ximage[SRC] and give back the one
+   we had. False if there is no new one of the size we need */
+int
+take_frame(void) {
+	uint64_t n;
+	struct slot *s;
+	int i, newest = -1;
+
+	/* only to clear the eventfd, the ring says what is new. It is
+	   EAGAIN when nothing was written since the last time */
+	if(read(capture_fd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		perror("read");
+
+	pthread_mutex_lock(&ring_lock);
+	for(i = 0; i < NRING; i++)
+		if(ring[i].state == SLOT_READY &&
+		   (newest < 0 || ring[i].seq > ring[newest].seq))
+			newest = i;
+
+	if(newest < 0) {
+		pthread_mutex_unlock(&ring_lock);
+		return False;
+	}
+
+	for(i = 0; i < NRING; i++)
+		if(i != newest &&
+		   (ring[i].state == SLOT_READY || ring[i].state == SLOT_SHOWN))
+			ring[i].state = SLOT_FREE;
+	s = &ring[newest];
+	s->state = SLOT_SHOWN;
+	if(shown_seq)
+		frames_dropped += s->seq - shown_seq - 1;
+	shown_seq = s->seq;
+	shown_slot = newest;
+	pthread_mutex_unlock(&ring_lock);
+
+	if(s->width != width[SRC] || s->height != height[SRC])
+		return False;		/* grabbed before a resize */
+
+	ximage[SRC] = s->image;
+	src_x = s->xgrab;
+	src_y = s->ygrab;
+	return True;
+}
+
+/* the frame in ximage[SRC] is still what we need, the cursor
+   alone can be drawn again over it */
+int
+frame_valid(void) {
+	return shown_slot >= 0 && ximage[SRC] == ring[shown_slot].image &&
+		ring[shown_slot].width == width[SRC] &&
+		ring[shown_slot].height == height[SRC];
+}
@@ -0,0 +1,73 @@
+/* draw the cursor into DST - parameterized by type T */
+/* SWAP, if T has more than one byte, reverses them: the pixels of
+   the cursor are values, DST may have them in the other byte order */
+/* (cx,cy) is where the top left pixel of the cursor image is in SRC.
+   every pixel of the image covers the block of DST where the kernels
+   put the source pixel under it (see zoom.h), so the cursor is
+   flipped, rotated and zoomed with the picture */
+
+/* get pixel address of point (x,y) in image t */
+#define getP(t,x,y) \
+	(T *) (&ximage[t]->data[(ximage[t]->xoffset+(x))*sizeof(T) + \
+	                        (y)*ximage[t]->bytes_per_line])
+
+{
+	int a, b, i, j, k, l, bw;
+	int sx, sy;
+	int p1step = ximage[DST]->bytes_per_line / sizeof(T);
+	unsigned char *m;
+	unsigned long *c;
+	T *p1, *p2, v;
+
+	for(b = 0; b < cursor_h; b++) {
+		sy = cy + b;
+		if(sy < 0 || sy >= height[SRC])
+			continue;
+
+		m = cursor_mask + b * cursor_w;
+		c = cursor_pixels + b * cursor_w;
+
+		for(a = 0; a < cursor_w; a++) {
+			sx = cx + a;
+			if(m[a] == CURSOR_CLEAR || sx < 0 || sx >= width[SRC])
+				continue;
+
+			if(flipxy) {
+				i = flipx ? height[SRC]-1-sy : sy;
+				j = flipy ? sx : width[SRC]-1-sx;
+			}
+			else {
+				i = flipx ? width[SRC]-1-sx : sx;
+				j = flipy ? height[SRC]-1-sy : sy;
+			}
+
+			p1 = getP(DST, block_x[i], block_y[j]);
+			bw = block_x[i+1] - block_x[i];
+			l = block_y[j+1] - block_y[j];
+
+			if(m[a] == CURSOR_INVERT) {
+				do {
+					p2 = p1;
+					k = bw;
+					do *p2++ ^= ~((T)0); while (--k > 0);
+					p1 += p1step;
+				} while (--l > 0);
+			}
+			else {
+				v = (T)c[a];
+#ifdef SWAP
+				if (swap_pixels)
+					v = SWAP(v);
+#endif
+				do {
+					p2 = p1;
+					k = bw;
+					do *p2++ = v; while (--k > 0);
+					p1 += p1step;
+				} while (--l > 0);
+			}
+		}
+	}
+}
+
+#undef getP
@@ -0,0 +1,88 @@
+/* the shared memory of -export, as xzoom writes it and readers
+   such as xzoomread.c map it.
+
+   The POSIX shared memory object (shm_open()) starts with a struct
+   export_header and has NEXPORT frames after it, each frame_size
+   bytes from offset frame_offset on. After every update xzoom copies
+   the picture of its first window into the frame after the latest
+   one and then makes it the latest. The pixels are those of the X
+   server: bits_per_pixel, the masks and the byte order say what they
+   are, the lines are packed.
+
+   Nothing is locked. Every frame has a sequence count which is odd
+   while xzoom writes the frame; a reader takes the count, reads the
+   frame and takes the count again, and if it was odd or changed in
+   between it tries again, see export_read_begin(). With NEXPORT
+   frames a reader has NEXPORT - 1 updates of time before the frame
+   it reads is written again. */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdint.h>
+
+#define EXPORT_MAGIC	0x787a6578		/* "xzex" */
+#define EXPORT_VERSION	1
+#define NEXPORT			3
+
+struct export_frame {
+	uint32_t seq;					/* odd while it is written */
+	uint32_t width, height;			/* of the picture */
+	uint32_t bytes_per_line;		/* width * bits_per_pixel / 8 */
+	uint64_t number;				/* of the update, from 1 on */
+	uint64_t time;					/* when it was made, usec */
+	int32_t src_x, src_y;			/* the source area */
+	uint32_t src_width, src_height;
+	double zoomx, zoomy;
+	uint32_t flipx, flipy, flipxy;
+	uint32_t filter;				/* 0 nearest, 1 bilinear */
+};
+
+struct export_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;					/* of this struct */
+	uint32_t nframes;				/* NEXPORT */
+	uint64_t frame_offset;			/* of frame 0 from the start */
+	uint64_t frame_size;			/* bytes from one frame to the next */
+	uint32_t bits_per_pixel, depth;
+	uint32_t red_mask, green_mask, blue_mask;
+	uint32_t byte_order;			/* 0 LSBFirst, 1 MSBFirst */
+	uint32_t pid;					/* of xzoom */
+	uint32_t closed;				/* xzoom is gone */
+	uint64_t number;				/* of the latest frame, 0 if none */
+	uint32_t latest;				/* index of the latest frame */
+	uint32_t pad;
+	struct export_frame frames[NEXPORT];
+};
+
+/* xzoom: before and after writing frame f */
+static inline void
+export_write_begin(struct export_frame *f) {
+	__atomic_store_n(&f->seq, f->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void
+export_write_end(struct export_frame *f) {
+	__atomic_store_n(&f->seq, f->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* readers: the count to give export_read_retry() after reading f */
+static inline uint32_t
+export_read_begin(struct export_frame *f) {
+	uint32_t seq;
+
+	while((seq = __atomic_load_n(&f->seq, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return seq;
+}
+
+/* true if f changed while it was read */
+static inline int
+export_read_retry(struct export_frame *f, uint32_t seq) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&f->seq, __ATOMIC_RELAXED) != seq;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/* scale image from SRC to DST with the tables of zoom.h - parameterized by type T */
+/* only lines j0 .. j1-1 and columns i0 .. i1-1 of DST (in blocks,
+   like scale.h) are done */
+/* without BLEND every pixel is that of its block (nearest), with
+   BLEND(a, b, w) the four source pixels around it are mixed (down
+   with BLEND_LINE(dst, a, b, n, w) if there is one for T): the
+   two source lines around a line of DST are mixed across into row0
+   and row1 first, the two lines of blend_rows of this thread (see
+   zoom.h), which are kept for the next lines of DST as long as they
+   fall between the same two source lines */
+/* the grid is the same as that of scale.h: the last column and the
+   last line of every block are inverted when the zoom is 2 or more.
+   Without BLEND that is done as the pixels are stored, like scale.h */
+
+{
+	int u0 = block_x[i0];				/* first column of DST */
+	int u1 = block_x[i1];				/* and the one after the last */
+	int n = u1 - u0;
+	int p1step = ximage[DST]->bytes_per_line / sizeof(T);
+	T *src = (T *)ximage[SRC]->data;
+	T *p1, *p2;
+	int i, j, u, v;
+#ifdef BLEND
+	T *s0, *row0, *row1, *t;
+	int off0 = -1, off1 = -1;			/* source lines in row0 and row1 */
+	int w, k;
+#else
+	T *s0;
+#endif
+
+#ifdef BLEND
+	row0 = (T *)(blend_rows + 2 * blend_thread * blend_row_size);
+	row1 = (T *)(blend_rows + (2 * blend_thread + 1) * blend_row_size);
+#endif
+
+	for (j = j0; j < j1; j++) {
+#ifdef BLEND
+		for (v = block_y[j]; v < block_y[j + 1]; v++) {
+			p1 = (T *)ximage[DST]->data + v * p1step;
+			w = line_w[v];
+
+			/* the line below may have been in row1 */
+			if (line_off0[v] != off0 && line_off0[v] == off1) {
+				t = row0; row0 = row1; row1 = t;
+				off1 = off0;
+				off0 = line_off0[v];
+			}
+			for (k = 0; k < 2; k++) {
+				if (k == 0 && line_off0[v] != off0) {
+					off0 = line_off0[v];
+					t = row0;
+				}
+				else if (k == 1 && w && line_off1[v] != off1) {
+					off1 = line_off1[v];
+					t = row1;
+				}
+				else
+					continue;
+				s0 = src + (k ? off1 : off0);
+				for (u = u0; u < u1; u++)
+					t[u] = BLEND(s0[col_off0[u]], s0[col_off1[u]], col_w[u]);
+			}
+
+			if (w == 0)
+				memcpy(p1 + u0, row0 + u0, n * sizeof(T));
+			else
+#ifdef BLEND_LINE
+				BLEND_LINE(p1 + u0, row0 + u0, row1 + u0, n, w);
+#else
+				for (u = u0; u < u1; u++)
+					p1[u] = BLEND(row0[u], row1[u], w);
+#endif
+
+			/* draw vertical grid */
+			if (gridy && zoomx >= 2)
+				for (i = i0 + 1; i <= i1; i++)
+					p1[block_x[i] - 1] ^= ~((T)0);
+		}
+		p2 = (T *)ximage[DST]->data + (block_y[j + 1] - 1) * p1step;
+#else
+		p1 = (T *)ximage[DST]->data + block_y[j] * p1step;
+		s0 = src + line_off0[block_y[j]];
+
+		/* a block is at least 2 wide with the grid, its last
+		   column inverted */
+		if (gridy && zoomx >= 2)
+			for (i = i0; i < i1; i++) {
+				for (u = block_x[i]; u < block_x[i + 1] - 1; u++)
+					p1[u] = s0[col_off0[u]];
+				p1[u] = ~s0[col_off0[u]];
+			}
+		else {
+			T *d = p1 + u0;
+			const int *o = col_off0 + u0;
+
+			for (u = 0; u < n; u++)
+				d[u] = s0[o[u]];
+		}
+
+		/* duplicate that line as needed, the last one inverted
+		   for the horizontal grid */
+		p2 = p1;
+		for (v = block_y[j] + 1; v < block_y[j + 1]; v++) {
+			p2 += p1step;
+			if (v == block_y[j + 1] - 1 && gridx && zoomy >= 2)
+				inv_line(p2 + u0, p1 + u0, n * sizeof(T));
+			else
+				dup_line(p2 + u0, p1 + u0, n * sizeof(T));
+		}
+#endif
+
+#ifdef BLEND
+		/* draw horizontal grid */
+		if (gridx && zoomy >= 2)
+			for (u = u0; u < u1; u++)
+				p2[u] ^= ~((T)0);
+#endif
+	}
+}
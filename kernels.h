@@ -0,0 +1,102 @@
+/* instantiate scale.h for pixels of type T - parameterized by T, REP,
+   SCALE (name of the generic kernel), SCALE_TABLE, MIX and MIX_LINE.
+
+   Besides the generic kernel SCALE() there is one kernel for each
+   magx in FIXED_MAGS and each orientation, named SCALE_<magx><o>,
+   where o is n (normal), x (flipx) or z (flipxy). With flipxy the
+   x flip only changes the direction we step in SRC, so it needs no
+   kernel of its own, and flipy only changes which line we start
+   from. SCALE_TABLE[m][o] holds them, see select_kernel(). */
+
+#define KNAME_(s, m, o)	s##_##m##o
+#define KNAME(s, m, o)	KNAME_(s, m, o)
+
+void SCALE(int j0, int j1, int i0, int i1)
+#include "scale.h"
+
+#define MAGX_CONST 2
+#define ORIENT ORIENT_NONE
+static void KNAME(SCALE, 2, n)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_X
+static void KNAME(SCALE, 2, x)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_XY
+static void KNAME(SCALE, 2, z)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#undef MAGX_CONST
+
+#define MAGX_CONST 3
+#define ORIENT ORIENT_NONE
+static void KNAME(SCALE, 3, n)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_X
+static void KNAME(SCALE, 3, x)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_XY
+static void KNAME(SCALE, 3, z)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#undef MAGX_CONST
+
+#define MAGX_CONST 4
+#define ORIENT ORIENT_NONE
+static void KNAME(SCALE, 4, n)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_X
+static void KNAME(SCALE, 4, x)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_XY
+static void KNAME(SCALE, 4, z)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#undef MAGX_CONST
+
+#define MAGX_CONST 8
+#define ORIENT ORIENT_NONE
+static void KNAME(SCALE, 8, n)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_X
+static void KNAME(SCALE, 8, x)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#define ORIENT ORIENT_XY
+static void KNAME(SCALE, 8, z)(int j0, int j1, int i0, int i1)
+#include "scale.h"
+#undef ORIENT
+#undef MAGX_CONST
+
+static void (*SCALE_TABLE[NFIXED][NORIENT])(int, int, int, int) = {
+	{ KNAME(SCALE, 2, n), KNAME(SCALE, 2, x), KNAME(SCALE, 2, z) },
+	{ KNAME(SCALE, 3, n), KNAME(SCALE, 3, x), KNAME(SCALE, 3, z) },
+	{ KNAME(SCALE, 4, n), KNAME(SCALE, 4, x), KNAME(SCALE, 4, z) },
+	{ KNAME(SCALE, 8, n), KNAME(SCALE, 8, x), KNAME(SCALE, 8, z) },
+};
+
+/* the kernels of fscale.h for fractional zooms, SCALE_frac(), and
+   if MIX names a blend function for T, SCALE_bilinear(). MIX_LINE
+   may name one that blends whole lines */
+void KNAME(SCALE, frac, )(int j0, int j1, int i0, int i1)
+#include "fscale.h"
+
+#ifdef MIX
+#define BLEND MIX
+#ifdef MIX_LINE
+#define BLEND_LINE MIX_LINE
+#endif
+void KNAME(SCALE, bilinear, )(int j0, int j1, int i0, int i1)
+#include "fscale.h"
+#undef BLEND_LINE
+#undef BLEND
+#endif
+
+#undef KNAME_
+#undef KNAME
@@ -0,0 +1,125 @@
+/* packed 24 bit pixels, 3 bytes each, as some servers have them for
+   depth 24.
+
+   There is no C type of 3 bytes, so scale.h, fscale.h and cursor.h
+   cannot be made for them. scale24() does what fscale.h does without
+   BLEND, for whole and fractional zooms alike, with the tables of
+   zoom.h, which are in bytes for these pixels. draw_cursor24() does
+   what cursor.h does. A pixel is loaded with a 4 byte load into the
+   first 3 bytes of an int and stored with a 4 byte store, the byte
+   after it is stored again with the next pixel; only the last pixel
+   of the columns done is stored with 3 bytes, so nothing after them
+   is touched. 3 byte loads and stores are several times slower. The
+   bytes are moved as they are, so their order only matters for the
+   cursor. */
+
+/* the pixel at p, in the first 3 bytes of the int in memory. The
+   byte after it is read too, unless that is end or after it */
+static inline unsigned int
+get24(const unsigned char *p, const unsigned char *end) {
+	unsigned int c = 0;
+
+	if(p + 4 <= end)
+		memcpy(&c, p, 4);
+	else
+		memcpy(&c, p, 3);
+	return c;
+}
+
+void
+scale24(int j0, int j1, int i0, int i1) {
+	int u0 = block_x[i0];				/* first column of DST */
+	int n = block_x[i1] - u0;			/* columns of DST */
+	int p1step = ximage[DST]->bytes_per_line;
+	int grid = gridy && zoomx >= 2;		/* vertical grid */
+	unsigned char *src = (unsigned char *)ximage[SRC]->data;
+	unsigned char *end = src + (height[SRC] - 1) *
+		ximage[SRC]->bytes_per_line + 3 * width[SRC];
+	unsigned char *p1, *p2, *p, *s0;
+	unsigned int c, last;
+	int i, j, k, v;
+
+	for(j = j0; j < j1; j++) {
+		p1 = (unsigned char *)ximage[DST]->data + block_y[j] * p1step;
+		s0 = src + line_off0[block_y[j]];
+
+		p = p1 + 3 * u0;
+		for(i = i0; i < i1; i++) {
+			c = get24(s0 + col_off0[block_x[i]], end);
+			last = grid ? ~c : c;
+			for(k = block_x[i + 1] - block_x[i] - 1; k > 0; k--) {
+				memcpy(p, &c, 4);
+				p += 3;
+			}
+			if(i < i1 - 1)
+				memcpy(p, &last, 4);
+			else
+				memcpy(p, &last, 3);
+			p += 3;
+		}
+
+		/* duplicate that line as needed, the last one inverted
+		   for the horizontal grid */
+		p2 = p1;
+		for(v = block_y[j] + 1; v < block_y[j + 1]; v++) {
+			p2 += p1step;
+			if(v == block_y[j + 1] - 1 && gridx && zoomy >= 2)
+				inv_line(p2 + 3 * u0, p1 + 3 * u0, 3 * n);
+			else
+				dup_line(p2 + 3 * u0, p1 + 3 * u0, 3 * n);
+		}
+	}
+}
+
+/* cursor.h for 24 bit pixels */
+void
+draw_cursor24(int cx, int cy) {
+	int p1step = ximage[DST]->bytes_per_line;
+	int msb = ximage[DST]->byte_order == MSBFirst;
+	int a, b, i, j, k, l, bw, sx, sy;
+	unsigned char *m, *p1, *p2, v[3];
+	unsigned long *c;
+
+	for(b = 0; b < cursor_h; b++) {
+		sy = cy + b;
+		if(sy < 0 || sy >= height[SRC])
+			continue;
+
+		m = cursor_mask + b * cursor_w;
+		c = cursor_pixels + b * cursor_w;
+
+		for(a = 0; a < cursor_w; a++) {
+			sx = cx + a;
+			if(m[a] == CURSOR_CLEAR || sx < 0 || sx >= width[SRC])
+				continue;
+
+			if(flipxy) {
+				i = flipx ? height[SRC]-1-sy : sy;
+				j = flipy ? sx : width[SRC]-1-sx;
+			}
+			else {
+				i = flipx ? width[SRC]-1-sx : sx;
+				j = flipy ? height[SRC]-1-sy : sy;
+			}
+
+			p1 = (unsigned char *)ximage[DST]->data +
+				block_y[j] * p1step + block_x[i] * 3;
+			bw = 3 * (block_x[i+1] - block_x[i]);
+			l = block_y[j+1] - block_y[j];
+
+			v[0] = c[a] >> (msb ? 16 : 0);
+			v[1] = c[a] >> 8;
+			v[2] = c[a] >> (msb ? 0 : 16);
+			do {
+				p2 = p1;
+				if(m[a] == CURSOR_INVERT)
+					for(k = 0; k < bw; k++)
+						p2[k] ^= 0xff;
+				else
+					for(k = 0; k < bw; k += 3)
+						memcpy(p2 + k, v, 3);
+				p1 += p1step;
+			} while(--l > 0);
+		}
+	}
+}
@@ -0,0 +1,280 @@
+/* recording of the source area, enabled with -record file.
+
+   After each update main() copies the source area of the first view
+   from ximage[SRC] into a ring of NRECORD frames, and a thread of its
+   own converts them and writes them to the file, one write() for each
+   frame. main() never waits for the disk: when the ring is full the
+   frame is dropped and counted.
+
+   A file ending in .y4m gets YUV4MPEG2 with 4:4:4 chroma, anything
+   else a stream of binary PPM images. Either way it plays at
+   RECORD_FPS frames per second, frames which were shown longer are
+   repeated. The size is that of the source area of the first frame,
+   frames of another size are dropped. The pointer is not in it. */
+
+#define NRECORD		8				/* frames in the ring */
+#define RECORD_FPS	25
+
+struct recorded {
+	char *data;						/* width * height packed pixels */
+	long long time;					/* when it was shown, usec */
+};
+
+char *record_name = NULL;			/* -record */
+int record_fd;
+int record_y4m;						/* or PPM */
+int record_width, record_height;	/* of every frame */
+int record_bpp;						/* bytes per pixel */
+int record_msb;						/* pixels are MSBFirst */
+unsigned long record_mask[3];		/* red, green and blue */
+unsigned char record_map[256][3];	/* pixel to RGB for 8 bit colormaps */
+int record_mapped = False;
+long long record_dropped = 0;
+pthread_t record_thread;
+unsigned char *record_out;			/* a frame as it goes into the file */
+
+/* all below is shared with the writer thread */
+pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t record_cond = PTHREAD_COND_INITIALIZER;
+struct recorded record_ring[NRECORD];
+int record_head = 0;				/* next one main() fills */
+int record_count = 0;				/* filled, not written yet */
+int record_done = False;			/* no more frames coming */
+
+/* the 8 bit value of a channel of pixel p */
+static unsigned int
+record_channel(unsigned long p, unsigned long mask) {
+	unsigned long max;
+
+	if(!mask)
+		return 0;
+	while(!(mask & 1)) {
+		mask >>= 1;
+		p >>= 1;
+	}
+	max = mask;
+	return (p & max) * 255 / max;
+}
+
+/* the RGB of the pixel at p */
+static void
+record_rgb(unsigned char *p, unsigned char *rgb) {
+	unsigned long pixel = 0;
+	int k;
+
+	if(record_msb)
+		for(k = 0; k < record_bpp; k++)
+			pixel = pixel << 8 | p[k];
+	else
+		for(k = record_bpp - 1; k >= 0; k--)
+			pixel = pixel << 8 | p[k];
+
+	if(record_mapped) {
+		memcpy(rgb, record_map[pixel & 0xff], 3);
+		return;
+	}
+	for(k = 0; k < 3; k++)
+		rgb[k] = record_channel(pixel, record_mask[k]);
+}
+
+/* frame f as it goes into the file, into out. Returns its size */
+size_t
+record_encode(struct recorded *f, unsigned char *out) {
+	int n = record_width * record_height;
+	unsigned char *p = (unsigned char *)f->data;
+	unsigned char rgb[3];
+	int i, r, g, b, header;
+
+	if(!record_y4m) {
+		header = sprintf((char *)out, "P6\n%d %d\n255\n",
+			record_width, record_height);
+		for(i = 0; i < n; i++, p += record_bpp)
+			record_rgb(p, out + header + 3 * i);
+		return header + 3 * n;
+	}
+
+	header = sprintf((char *)out, "FRAME\n");
+	out += header;
+	for(i = 0; i < n; i++, p += record_bpp) {
+		record_rgb(p, rgb);
+		r = rgb[0];
+		g = rgb[1];
+		b = rgb[2];
+		/* BT.601, video range */
+		out[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+		out[n + i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+		out[2 * n + i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+	}
+	return header + 3 * n;
+}
+
+/* write all of buf, False if that failed */
+int
+record_write(unsigned char *buf, size_t size) {
+	ssize_t n;
+
+	while(size > 0) {
+		n = write(record_fd, buf, size);
+		if(n < 0) {
+			perror(record_name);
+			return False;
+		}
+		buf += n;
+		size -= n;
+	}
+	return True;
+}
+
+void *
+record_writer(void *arg) {
+	struct recorded *f;
+	size_t size = 0;
+	long long start = 0, frames = 0, due;
+	int ok = True, tail;
+
+	pthread_mutex_lock(&record_lock);
+	for(;;) {
+		while(record_count == 0 && !record_done)
+			pthread_cond_wait(&record_cond, &record_lock);
+		if(record_count == 0)
+			break;
+		tail = (record_head + NRECORD - record_count) % NRECORD;
+		f = &record_ring[tail];
+		pthread_mutex_unlock(&record_lock);
+
+		/* the last frame stays until this one was shown */
+		if(frames == 0)
+			start = f->time;
+		due = (f->time - start) * RECORD_FPS / 1000000;
+		for(; ok && frames > 0 && frames < due; frames++)
+			ok = record_write(record_out, size);
+
+		size = record_encode(f, record_out);
+		if(ok)
+			ok = record_write(record_out, size);
+		frames++;
+
+		pthread_mutex_lock(&record_lock);
+		record_count--;
+	}
+	pthread_mutex_unlock(&record_lock);
+	return NULL;
+}
+
+/* let the writer write what is left and close the file */
+void
+finish_record(void) {
+	pthread_mutex_lock(&record_lock);
+	record_done = True;
+	pthread_cond_signal(&record_cond);
+	pthread_mutex_unlock(&record_lock);
+	pthread_join(record_thread, NULL);
+	close(record_fd);
+
+	if(record_dropped)
+		fprintf(stderr, "%s: %lld frames not recorded\n",
+			progname, record_dropped);
+}
+
+/* open the file and start the writer, for frames of the size
+   and format of ximage[SRC] */
+void
+init_record(void) {
+	Visual *visual = DefaultVisualOfScreen(scr);
+	XColor colors[256];
+	char header[80];
+	int i, n;
+
+	n = strlen(record_name);
+	record_y4m = n > 4 && !strcmp(record_name + n - 4, ".y4m");
+	record_width = width[SRC];
+	record_height = height[SRC];
+	record_bpp = ximage[SRC]->bits_per_pixel / 8;
+	record_msb = ximage[SRC]->byte_order == MSBFirst;
+	record_mask[0] = visual->red_mask;
+	record_mask[1] = visual->green_mask;
+	record_mask[2] = visual->blue_mask;
+
+	/* with a colormap the pixels are looked up, as they are now */
+	if(visual->class != TrueColor && visual->class != DirectColor &&
+	   record_bpp == 1) {
+		for(i = 0; i < 256; i++)
+			colors[i].pixel = i;
+		XQueryColors(dpy, DefaultColormapOfScreen(scr), colors,
+			visual->map_entries < 256 ? visual->map_entries : 256);
+		for(i = 0; i < 256; i++) {
+			record_map[i][0] = colors[i].red >> 8;
+			record_map[i][1] = colors[i].green >> 8;
+			record_map[i][2] = colors[i].blue >> 8;
+		}
+		record_mapped = True;
+	}
+
+	record_fd = open(record_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(record_fd < 0) {
+		perror(record_name);
+		exit(-1);
+	}
+
+	if(record_y4m) {
+		sprintf(header, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+			record_width, record_height, RECORD_FPS);
+		if(!record_write((unsigned char *)header, strlen(header)))
+			exit(-1);
+	}
+
+	/* room for the header of a frame and 3 bytes for each pixel */
+	record_out = malloc(32 + 3 * record_width * record_height);
+	if(!record_out) {
+		perror("malloc");
+		exit(-1);
+	}
+
+	for(i = 0; i < NRECORD; i++) {
+		record_ring[i].data = malloc(record_width * record_height *
+			record_bpp);
+		if(!record_ring[i].data) {
+			perror("malloc");
+			exit(-1);
+		}
+	}
+
+	if(pthread_create(&record_thread, NULL, record_writer, NULL)) {
+		perror("pthread_create");
+		exit(-1);
+	}
+	atexit(finish_record);
+}
+
+/* put the source area just shown into the ring */
+void
+record_frame(void) {
+	struct recorded *f;
+	int n, y;
+
+	if(record_width == 0)
+		init_record();
+
+	pthread_mutex_lock(&record_lock);
+	if(record_count == NRECORD ||
+	   width[SRC] != record_width || height[SRC] != record_height) {
+		record_dropped++;
+		pthread_mutex_unlock(&record_lock);
+		return;
+	}
+	f = &record_ring[record_head];
+	pthread_mutex_unlock(&record_lock);
+
+	/* the writer does not touch it before record_count says so */
+	n = record_width * record_bpp;
+	for(y = 0; y < record_height; y++)
+		memcpy(f->data + y * n,
+			ximage[SRC]->data + y * ximage[SRC]->bytes_per_line, n);
+	f->time = now_usec();
+
+	pthread_mutex_lock(&record_lock);
+	record_head = (record_head + 1) % NRECORD;
+	record_count++;
+	pthread_cond_signal(&record_cond);
+	pthread_mutex_unlock(&record_lock);
+}
@@ -0,0 +1,408 @@
+/* pixel replication routines used by scale.h.
+
+   rep8(), rep16() and rep32() read n pixels from src, stepping
+   step pixels each time, and write each of them mag times to dst;
+   with grid the last of the mag is inverted, which is the vertical
+   grid, in the same stores. dup_line() copies one already scaled
+   line to the next ones, inv_line() copies it inverted, which is
+   the horizontal grid.
+   blend_line32() mixes two lines of 32 bit pixels, w / 256 of b and
+   the rest of a in each byte, for the bilinear filter of fscale.h.
+
+   On x86 SSE2, AVX2 and AVX-512 versions are selected at startup
+   by init_replicate(). They give exactly the same output as the
+   plain C ones. */
+
+void (*rep8)(unsigned char *dst, const unsigned char *src,
+	int step, int n, int mag, int grid);
+void (*rep16)(unsigned short *dst, const unsigned short *src,
+	int step, int n, int mag, int grid);
+void (*rep32)(unsigned int *dst, const unsigned int *src,
+	int step, int n, int mag, int grid);
+void (*dup_line)(void *dst, const void *src, int nbytes);
+void (*inv_line)(void *dst, const void *src, int nbytes);
+void (*blend_line32)(unsigned int *dst, const unsigned int *a,
+	const unsigned int *b, int n, int w);
+int rep_simd = False;			/* rep8() etc. are vector routines */
+
+/* plain C, one store per destination pixel */
+#define REP_C(name, T) \
+static void \
+name(T *dst, const T *src, int step, int n, int mag, int grid) \
+{ \
+	int k; \
+	\
+	if (n <= 0) \
+		return; \
+	do { \
+		T c = *src; src += step; \
+		k = mag; do *dst++ = c; while (--k > 0); \
+		if (grid) \
+			dst[-1] = ~c; \
+	} while (--n > 0); \
+}
+
+REP_C(rep8_c, unsigned char)
+REP_C(rep16_c, unsigned short)
+REP_C(rep32_c, unsigned int)
+
+static void
+dup_line_c(void *dst, const void *src, int nbytes)
+{
+	memcpy(dst, src, nbytes);
+}
+
+static void
+inv_line_c(void *dst, const void *src, int nbytes)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+
+	while (nbytes-- > 0)
+		*d++ = ~*s++;
+}
+
+static void
+blend_line32_c(unsigned int *dst, const unsigned int *a,
+	const unsigned int *b, int n, int w)
+{
+	unsigned int rb, ag;
+
+	while (n-- > 0) {
+		rb = ((*a & 0xff00ff) * (256 - w) + (*b & 0xff00ff) * w) >> 8;
+		ag = (*a >> 8 & 0xff00ff) * (256 - w) + (*b >> 8 & 0xff00ff) * w;
+		*dst++ = (rb & 0xff00ff) | (ag & 0xff00ff00);
+		a++; b++;
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_REPLICATE
+#endif
+
+#ifdef SIMD_REPLICATE
+#include <immintrin.h>
+
+#define SSE2	__attribute__((target("sse2")))
+#define AVX2	__attribute__((target("avx2")))
+#define AVX512	__attribute__((target("avx512f,avx512bw")))
+
+/* one vector store per source pixel: a broadcast of the pixel is
+   stored at dst, dst+lanes, ... until mag pixels are covered.
+   The part beyond dst+mag is overwritten by the next pixel, so we
+   stop while a whole store still fits and do the rest in C. The
+   grid pixel goes in after the stores of its pixel */
+#define REP_BCAST(T, VT, SET1, STORE) \
+	{ \
+		const int lanes = sizeof(VT) / sizeof(T); \
+		int safe = (mag + lanes - 1) / lanes * lanes; \
+		int k; \
+		\
+		while (n > 0 && n * mag >= safe) { \
+			T c = *src; \
+			VT v = SET1(c); \
+			k = 0; \
+			do { \
+				STORE((VT *)(dst + k), v); \
+				k += lanes; \
+			} while (k < mag); \
+			if (grid) \
+				dst[mag - 1] = ~c; \
+			src += step; dst += mag; n--; \
+		} \
+	}
+
+/* for the unpacks: a vector of pixels with the last of every mag
+   inverted when there is a grid, xored into every store. Every store
+   starts at the first pixel of a group of mag */
+#define GRID_VECTOR(T, VT, LOAD) \
+	T pat_[sizeof(VT) / sizeof(T)]; \
+	VT g; \
+	int i_; \
+	\
+	for (i_ = 0; i_ < (int)(sizeof(VT) / sizeof(T)); i_++) \
+		pat_[i_] = grid && i_ % mag == mag - 1 ? (T)~0 : 0; \
+	g = LOAD((const VT *)pat_)
+
+/* reverse the order of the pixels in a vector */
+static inline __m128i SSE2
+rev32_sse2(__m128i v)
+{
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0,1,2,3));
+}
+
+static inline __m128i SSE2
+rev16_sse2(__m128i v)
+{
+	v = rev32_sse2(v);
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+}
+
+static inline __m128i SSE2
+rev8_sse2(__m128i v)
+{
+	v = rev16_sse2(v);
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m256i AVX2
+rev32_avx2(__m256i v)
+{
+	v = _mm256_shuffle_epi32(v, _MM_SHUFFLE(0,1,2,3));
+	return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1,0,3,2));
+}
+
+static inline __m256i AVX2
+rev16_avx2(__m256i v)
+{
+	v = rev32_avx2(v);
+	v = _mm256_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+	return _mm256_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+}
+
+static inline __m256i AVX2
+rev8_avx2(__m256i v)
+{
+	v = rev16_avx2(v);
+	return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+/* AVX2 unpacks work inside 128 bit lanes, put the halves back in
+   order, with the grid vector g */
+#define AVX2_STORE2(p, lo, hi) \
+	do { \
+		_mm256_storeu_si256((__m256i *)(p), _mm256_xor_si256(g, \
+			_mm256_permute2x128_si256(lo, hi, 0x20))); \
+		_mm256_storeu_si256((__m256i *)(p) + 1, _mm256_xor_si256(g, \
+			_mm256_permute2x128_si256(lo, hi, 0x31))); \
+	} while (0)
+
+#define SSE2_STORE(p, v) \
+	_mm_storeu_si128((__m128i *)(p), _mm_xor_si128(g, v))
+
+/* SSE2 and AVX2 versions for each pixel size. For mag 2 and 4 with
+   step 1 or -1 whole vectors of source pixels are loaded, reversed
+   for -1, and doubled with unpack; anything else uses REP_BCAST */
+#define REP_SIMD(bits, T) \
+static void SSE2 \
+rep##bits##_sse2(T *dst, const T *src, int step, int n, int mag, int grid) \
+{ \
+	const int lanes = 16 / sizeof(T); \
+	\
+	if ((mag == 2 || mag == 4) && (step == 1 || step == -1)) { \
+		GRID_VECTOR(T, __m128i, _mm_loadu_si128); \
+		\
+		while (n >= lanes) { \
+			__m128i v, lo, hi; \
+			\
+			if (step == 1) \
+				v = _mm_loadu_si128((const __m128i *)src); \
+			else \
+				v = rev##bits##_sse2(_mm_loadu_si128( \
+					(const __m128i *)(src - lanes + 1))); \
+			lo = _mm_unpacklo_epi##bits(v, v); \
+			hi = _mm_unpackhi_epi##bits(v, v); \
+			if (mag == 2) { \
+				SSE2_STORE((__m128i *)dst, lo); \
+				SSE2_STORE((__m128i *)dst + 1, hi); \
+			} \
+			else { \
+				SSE2_STORE((__m128i *)dst, \
+					_mm_unpacklo_epi##bits(lo, lo)); \
+				SSE2_STORE((__m128i *)dst + 1, \
+					_mm_unpackhi_epi##bits(lo, lo)); \
+				SSE2_STORE((__m128i *)dst + 2, \
+					_mm_unpacklo_epi##bits(hi, hi)); \
+				SSE2_STORE((__m128i *)dst + 3, \
+					_mm_unpackhi_epi##bits(hi, hi)); \
+			} \
+			src += step * lanes; dst += mag * lanes; n -= lanes; \
+		} \
+	} \
+	else \
+		REP_BCAST(T, __m128i, _mm_set1_epi##bits, _mm_storeu_si128) \
+	rep##bits##_c(dst, src, step, n, mag, grid); \
+} \
+\
+static void AVX2 \
+rep##bits##_avx2(T *dst, const T *src, int step, int n, int mag, int grid) \
+{ \
+	const int lanes = 32 / sizeof(T); \
+	\
+	if ((mag == 2 || mag == 4) && (step == 1 || step == -1)) { \
+		GRID_VECTOR(T, __m256i, _mm256_loadu_si256); \
+		\
+		while (n >= lanes) { \
+			__m256i v, lo, hi; \
+			\
+			if (step == 1) \
+				v = _mm256_loadu_si256((const __m256i *)src); \
+			else \
+				v = rev##bits##_avx2(_mm256_loadu_si256( \
+					(const __m256i *)(src - lanes + 1))); \
+			lo = _mm256_unpacklo_epi##bits(v, v); \
+			hi = _mm256_unpackhi_epi##bits(v, v); \
+			if (mag == 2) \
+				AVX2_STORE2(dst, lo, hi); \
+			else { \
+				/* lo and hi have the doubled pixels of both \
+				   lanes, a and b put them back in order */ \
+				__m256i a = _mm256_permute2x128_si256(lo, hi, 0x20); \
+				__m256i b = _mm256_permute2x128_si256(lo, hi, 0x31); \
+				AVX2_STORE2(dst, _mm256_unpacklo_epi##bits(a, a), \
+					_mm256_unpackhi_epi##bits(a, a)); \
+				AVX2_STORE2(dst + 2 * lanes, \
+					_mm256_unpacklo_epi##bits(b, b), \
+					_mm256_unpackhi_epi##bits(b, b)); \
+			} \
+			src += step * lanes; dst += mag * lanes; n -= lanes; \
+		} \
+	} \
+	else if (mag * sizeof(T) <= 16) \
+		REP_BCAST(T, __m128i, _mm_set1_epi##bits, _mm_storeu_si128) \
+	else \
+		REP_BCAST(T, __m256i, _mm256_set1_epi##bits, _mm256_storeu_si256) \
+	rep##bits##_c(dst, src, step, n, mag, grid); \
+} \
+\
+static void AVX512 \
+rep##bits##_avx512(T *dst, const T *src, int step, int n, int mag, int grid) \
+{ \
+	/* wide stores only pay off when a pixel covers a whole vector */ \
+	if (mag * sizeof(T) < 64) { \
+		rep##bits##_avx2(dst, src, step, n, mag, grid); \
+		return; \
+	} \
+	REP_BCAST(T, __m512i, _mm512_set1_epi##bits, _mm512_storeu_si512) \
+	rep##bits##_c(dst, src, step, n, mag, grid); \
+}
+
+REP_SIMD(8, unsigned char)
+REP_SIMD(16, unsigned short)
+REP_SIMD(32, unsigned int)
+
+#define DUP_SIMD(name, attr, VT, LOAD, STORE) \
+static void attr \
+name(void *dst, const void *src, int nbytes) \
+{ \
+	char *d = dst; \
+	const char *s = src; \
+	\
+	while (nbytes >= (int)sizeof(VT)) { \
+		STORE((VT *)d, LOAD((const VT *)s)); \
+		d += sizeof(VT); s += sizeof(VT); nbytes -= sizeof(VT); \
+	} \
+	memcpy(d, s, nbytes); \
+}
+
+DUP_SIMD(dup_line_sse2, SSE2, __m128i, _mm_loadu_si128, _mm_storeu_si128)
+DUP_SIMD(dup_line_avx2, AVX2, __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+DUP_SIMD(dup_line_avx512, AVX512, __m512i, _mm512_loadu_si512, _mm512_storeu_si512)
+
+#define INV_SIMD(name, attr, VT, LOAD, STORE, SET1, XOR) \
+static void attr \
+name(void *dst, const void *src, int nbytes) \
+{ \
+	char *d = dst; \
+	const char *s = src; \
+	VT ones = SET1(-1); \
+	\
+	while (nbytes >= (int)sizeof(VT)) { \
+		STORE((VT *)d, XOR(LOAD((const VT *)s), ones)); \
+		d += sizeof(VT); s += sizeof(VT); nbytes -= sizeof(VT); \
+	} \
+	inv_line_c(d, s, nbytes); \
+}
+
+INV_SIMD(inv_line_sse2, SSE2, __m128i, _mm_loadu_si128, _mm_storeu_si128,
+	_mm_set1_epi32, _mm_xor_si128)
+INV_SIMD(inv_line_avx2, AVX2, __m256i, _mm256_loadu_si256,
+	_mm256_storeu_si256, _mm256_set1_epi32, _mm256_xor_si256)
+INV_SIMD(inv_line_avx512, AVX512, __m512i, _mm512_loadu_si512,
+	_mm512_storeu_si512, _mm512_set1_epi32, _mm512_xor_si512)
+
+/* the bytes of the pixels widened to 16 bits, where a * (256 - w) +
+   b * w still fits, so the result is the same as that of C */
+#define BLEND_SIMD(name, attr, VT, LOAD, STORE, SET1, ZERO, UNPACKLO, \
+	UNPACKHI, MUL, ADD, SRL, PACK) \
+static void attr \
+name(unsigned int *dst, const unsigned int *a, \
+	const unsigned int *b, int n, int w) \
+{ \
+	const int lanes = sizeof(VT) / 4; \
+	VT wa = SET1(256 - w), wb = SET1(w), zero = ZERO(); \
+	VT va, vb, lo, hi; \
+	\
+	while (n >= lanes) { \
+		va = LOAD((const VT *)a); \
+		vb = LOAD((const VT *)b); \
+		lo = ADD(MUL(UNPACKLO(va, zero), wa), MUL(UNPACKLO(vb, zero), wb)); \
+		hi = ADD(MUL(UNPACKHI(va, zero), wa), MUL(UNPACKHI(vb, zero), wb)); \
+		STORE((VT *)dst, PACK(SRL(lo, 8), SRL(hi, 8))); \
+		dst += lanes; a += lanes; b += lanes; n -= lanes; \
+	} \
+	blend_line32_c(dst, a, b, n, w); \
+}
+
+BLEND_SIMD(blend_line32_sse2, SSE2, __m128i, _mm_loadu_si128,
+	_mm_storeu_si128, _mm_set1_epi16, _mm_setzero_si128,
+	_mm_unpacklo_epi8, _mm_unpackhi_epi8, _mm_mullo_epi16,
+	_mm_add_epi16, _mm_srli_epi16, _mm_packus_epi16)
+BLEND_SIMD(blend_line32_avx2, AVX2, __m256i, _mm256_loadu_si256,
+	_mm256_storeu_si256, _mm256_set1_epi16, _mm256_setzero_si256,
+	_mm256_unpacklo_epi8, _mm256_unpackhi_epi8, _mm256_mullo_epi16,
+	_mm256_add_epi16, _mm256_srli_epi16, _mm256_packus_epi16)
+
+#undef SSE2
+#undef AVX2
+#undef AVX512
+#undef GRID_VECTOR
+#undef SSE2_STORE
+#undef AVX2_STORE2
+#endif /* SIMD_REPLICATE */
+
+/* pick the best routines this CPU can run */
+void
+init_replicate(void)
+{
+	rep8 = rep8_c;
+	rep16 = rep16_c;
+	rep32 = rep32_c;
+	dup_line = dup_line_c;
+	inv_line = inv_line_c;
+	blend_line32 = blend_line32_c;
+
+#ifdef SIMD_REPLICATE
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f") &&
+	    __builtin_cpu_supports("avx512bw")) {
+		rep8 = rep8_avx512;
+		rep16 = rep16_avx512;
+		rep32 = rep32_avx512;
+		dup_line = dup_line_avx512;
+		inv_line = inv_line_avx512;
+		blend_line32 = blend_line32_avx2;
+		rep_simd = True;
+	}
+	else if (__builtin_cpu_supports("avx2")) {
+		rep8 = rep8_avx2;
+		rep16 = rep16_avx2;
+		rep32 = rep32_avx2;
+		dup_line = dup_line_avx2;
+		inv_line = inv_line_avx2;
+		blend_line32 = blend_line32_avx2;
+		rep_simd = True;
+	}
+	else if (__builtin_cpu_supports("sse2")) {
+		rep8 = rep8_sse2;
+		rep16 = rep16_sse2;
+		rep32 = rep32_sse2;
+		dup_line = dup_line_sse2;
+		inv_line = inv_line_sse2;
+		blend_line32 = blend_line32_sse2;
+		rep_simd = True;
+	}
+#endif
+}
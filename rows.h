@@ -0,0 +1,131 @@
+/* rows on the server, enabled with -rows.
+
+   With the nearest filter all lines of a block of DST are the same
+   (but the grid). So the kernels scale only one row for each block,
+   into line j of DST for block j, see rows_tables(), and only those
+   rows are sent. On the server they go to the top of rows_pixmap,
+   each row is copied to its block below them and doubled there until
+   it fills the block, the grid is inverted into it, and the span is
+   copied into the window in one go. That makes scaling and sending
+   magy times cheaper, for a few small requests per block.
+
+   The copies are done in the pixmap rather than the window, which
+   may be partly covered. With the bilinear filter the lines of a
+   block differ, so it is all done the usual way then. */
+
+GC rows_gc = NULL;					/* copies without exposure events */
+GC rows_invert_gc = NULL;			/* the grid */
+int *rows_y = NULL;					/* block_y and line_off0 for rows */
+int *rows_off = NULL;
+int *saved_block_y, *saved_line_off0;
+int saved_magy;
+
+/* true if the view in the globals sends rows */
+int
+use_rows(void) {
+	return server_rows && filter == FILTER_NEAREST;
+}
+
+/* while on, the kernels and the cursor draw one row for each block
+   into DST: block_y counts rows, line_off0 has the source line of
+   each block and magy is 1. Off puts the tables back */
+void
+rows_tables(int on) {
+	int n = flipxy ? width[SRC] : height[SRC];
+	int j;
+
+	if(!on) {
+		block_y = saved_block_y;
+		line_off0 = saved_line_off0;
+		magy = saved_magy;
+		return;
+	}
+
+	rows_y = realloc(rows_y, (n + 1) * sizeof(int));
+	rows_off = realloc(rows_off, n * sizeof(int));
+	if(!rows_y || !rows_off) {
+		perror("realloc");
+		exit(-1);
+	}
+	for(j = 0; j <= n; j++)
+		rows_y[j] = j;
+	for(j = 0; j < n; j++)
+		rows_off[j] = line_off0[block_y[j]];
+
+	saved_block_y = block_y;
+	saved_line_off0 = line_off0;
+	saved_magy = magy;
+	block_y = rows_y;
+	line_off0 = rows_off;
+	magy = 1;
+}
+
+/* put the rows of blocks j0 .. j1-1, columns i0 .. i1-1, into
+   the window */
+void
+put_rows(int j0, int j1, int i0, int i1) {
+	int n = flipxy ? width[SRC] : height[SRC];
+	int y0 = block_y[j0];
+	int y1 = block_y[j1];
+	XRectangle *r;
+	XGCValues gcv;
+	int j, k, y, h, x0, x1, nr = 0;
+
+	span_columns(i0, i1, &x0, &x1);
+	if(y1 > height[DST])
+		y1 = height[DST];
+	if(y0 >= y1 || x0 >= x1)
+		return;
+
+	if(!rows_gc) {
+		gcv.graphics_exposures = False;
+		rows_gc = XCreateGC(dpy, win, GCGraphicsExposures, &gcv);
+		gcv.function = GXinvert;
+		gcv.plane_mask = AllPlanes;
+		rows_invert_gc = XCreateGC(dpy, win,
+			GCFunction|GCPlaneMask|GCGraphicsExposures, &gcv);
+	}
+	if(rows_pixmap == None ||
+	   rows_width != width[DST] || rows_height != n + height[DST]) {
+		if(rows_pixmap != None)
+			XFreePixmap(dpy, rows_pixmap);
+		rows_width = width[DST];
+		rows_height = n + height[DST];
+		rows_pixmap = XCreatePixmap(dpy, win, rows_width, rows_height,
+			DefaultDepthOfScreen(scr));
+	}
+
+	r = malloc((j1 - j0) * sizeof(XRectangle));
+	if(!r) {
+		perror("malloc");
+		exit(-1);
+	}
+
+	put_image(rows_pixmap, x0, x1, j0, j1, j0);
+
+	for(j = j0; j < j1 && block_y[j] < y1; j++) {
+		y = n + block_y[j];
+		h = (block_y[j + 1] < y1 ? block_y[j + 1] : y1) - block_y[j];
+
+		XCopyArea(dpy, rows_pixmap, rows_pixmap, rows_gc,
+			x0, j, x1 - x0, 1, x0, y);
+		for(k = 1; k < h; k *= 2)
+			XCopyArea(dpy, rows_pixmap, rows_pixmap, rows_gc,
+				x0, y, x1 - x0, k < h - k ? k : h - k, x0, y + k);
+
+		/* the last line of the block, if it is in the window */
+		if(gridx && zoomy >= 2 && block_y[j + 1] <= y1) {
+			r[nr].x = x0;
+			r[nr].y = y + h - 1;
+			r[nr].width = x1 - x0;
+			r[nr].height = 1;
+			nr++;
+		}
+	}
+	if(nr > 0)
+		XFillRectangles(dpy, rows_pixmap, rows_invert_gc, r, nr);
+	free(r);
+
+	XCopyArea(dpy, rows_pixmap, win, rows_gc,
+		x0, n + y0, x1 - x0, y1 - y0, x0, y0);
+}
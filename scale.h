@@ -1,29 +1,72 @@
 /* scale image from SRC to DST - parameterized by type T */
+/* REP is the routine from replicate.h which replicates pixels of type T */
+/* only lines j0 .. j1-1 of DST (in units of magy scanlines) and
+   columns i0 .. i1-1 (in units of magx pixels) are done */
+/* optional: MAGX_CONST and ORIENT make a kernel for one magx and
+   orientation, see kernels.h */
+/* the grid is drawn by the stores of the pixels themselves: REP
+   inverts the last copy of each pixel, inv_line() the last line */
 
 /* get pixel address of point (x,y) in image t */
 #define getP(t,x,y) \
 	(T *) (&ximage[t]->data[(ximage[t]->xoffset+(x))*sizeof(T) + \
 	                        (y)*ximage[t]->bytes_per_line])
 
+#ifdef ORIENT
+#define FLIPXY	(ORIENT == ORIENT_XY)
+#define FLIPX	(ORIENT == ORIENT_X)
+#else
+#define FLIPXY	flipxy
+#define FLIPX	flipx
+#endif
+
+#ifdef MAGX_CONST
+#define KMAGX	MAGX_CONST
+/* replicate n pixels from s, step apart, to p1 with a fixed count of
+   stores. The vector routines are faster for 2 and 4 on whole lines */
+#define REPLICATE(s, step, n) \
+	do { \
+		if ((KMAGX == 2 || KMAGX == 4) && (step == 1 || step == -1) && rep_simd) \
+			REP(p1, s, step, n, KMAGX, grid); \
+		else { \
+			T *s_ = (s); \
+			i = (n); \
+			do { \
+				T c = *s_; s_ += (step); \
+				k = KMAGX; do *p1++ = c; while (--k > 0); \
+				if (grid) \
+					p1[-1] = ~c; \
+			} while (--i > 0); \
+		} \
+	} while (0)
+#else
+#define KMAGX	magx
+#define REPLICATE(s, step, n)	REP(p1, s, step, n, magx, grid)
+#endif
+
 {
 	int i, j, k;
+	int grid = gridy && KMAGX >= 2;		/* vertical grid */
+
+	if (j0 >= j1 || i0 >= i1)
+		return;
 
 	/* copy scaled lines from SRC to DST */
-	j = flipxy ? width[SRC] - 1 : height[SRC] - 1;
+	j = j1 - 1;
 	do {
 		T *p1;
 		T *p2;
 		int p2step;
 		T *p1_save;
 
-		/* p1 point to begining of scanline j*magy in DST */
-		p1 = getP(DST,0,j*magy);
+		/* p1 point to column i0*magx of scanline j*magy in DST */
+		p1 = getP(DST,i0*KMAGX,j*magy);
 		p1_save = p1;
 		/* p2 point to begining of scanline j in SRC */
 		/* if flipy then line height[SRC]-1-j */
 		p2 = getP(SRC,0,flipy ? (height[SRC]-1-j) : j);
 
-		if (flipxy)
+		if (FLIPXY)
 		{
 			p2 = getP(SRC,flipy ? j : (width[SRC]-1-j),0);
 			p2step = ximage[SRC]->bytes_per_line / sizeof(T);
@@ -34,69 +77,43 @@
 				p2step = -p2step;
 			}
 
-			i = height[SRC];
-			do {
-				T c = *p2; p2 += p2step;
-				k = magx; do *p1++ = c; while (--k > 0);
-			} while (--i > 0);
+			REPLICATE(p2 + i0 * p2step, p2step, i1 - i0);
 		}
-		else if (flipx)
+		else if (FLIPX)
 		{
-			p2 += width[SRC];
-			i = width[SRC];
-			do {
-				T c = *--p2;
-				k = magx; do *p1++ = c; while (--k > 0);
-			} while (--i > 0);
+			REPLICATE(p2 + width[SRC] - 1 - i0, -1, i1 - i0);
 		}
 		else
 		{
-			i = width[SRC];
-			do {
-				T c = *p2++;
-				k = magx; do *p1++ = c; while (--k > 0);
-			} while (--i > 0);
-		}
-
-		/* draw vertical grid */
-		if (gridy && magx >= 2)
-		{
-			p1 = p1_save - 1;
-			i = magx;
-			k = flipxy ? height[SRC] : width[SRC];
-			do {
-				p1 += i;
-				*p1 ^= ~((T)0);
-			} while (--k > 0);
+			REPLICATE(p2 + i0, 1, i1 - i0);
 		}
 
-		/* duplicate that line as needed */
+		/* duplicate that line as needed, the last one inverted
+		   for the horizontal grid. All of the blocks, also past
+		   the window, they may be moved into it by shift_buffer() */
 		if (magy > 1)
 		{
-			/* p1 point to begining of scanline j*magy in DST */
+			/* p1 point to column i0*magx of scanline j*magy in DST */
 			p1 = p1_save;
-			/* p2 points to begining of next line */
+			/* p2 points to the same column of the next line */
 			p2 = p1;
 			p2step = ximage[DST]->bytes_per_line / sizeof(T);
 
-			i = width[DST] * sizeof(T);
-			k = magy - 1;
-			do {
+			i = (i1 - i0) * KMAGX * sizeof(T);
+			k = gridx ? magy - 2 : magy - 1;
+			while (k-- > 0) {
 				p2 += p2step;
-				memcpy(p2, p1, i);
-			} while (--k > 0);
-
-			/* draw horizontal grid */
-			if (gridx && magy >= 2)
-			{
-				k = width[DST];
-				do {
-					*p2++ ^= ~((T)0);
-				} while (--k > 0);
+				dup_line(p2, p1, i);
 			}
+			if (gridx)
+				inv_line(p2 + p2step, p1, i);
 		}
-	} while (--j >= 0);
+	} while (--j >= j0);
 }
 
 #undef getP
+#undef FLIPXY
+#undef FLIPX
+#undef KMAGX
+#undef REPLICATE
 
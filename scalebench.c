@@ -0,0 +1,748 @@
+/* scalebench - benchmark for the xzoom scaling kernels.
+
+   Runs the kernels of scale.h and fscale.h (through kernels.h,
+   replicate.h and zoom.h, exactly as xzoom builds them) on XImage
+   structures that point to plain malloc()ed buffers, so no X server
+   is needed. For every combination of depth, magx, magy, filter,
+   orientation, grid and window size it reports destination Mpixel/s
+   and MB/s, and compares the output with a slow reference
+   implementation.
+
+   scalebench -check compares every magx and magy from 1 to 16, and
+   the fractional zooms with both filters, in every depth, orientation
+   and grid setting, the zooms also with the pixels in the other byte
+   order, and exits with 1 if anything differs. Depth 24 is packed 3
+   byte pixels. See Usage() for the rest. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define SRC		0				/* index for source image */
+#define	DST		1				/* index for dest image */
+
+/* what scale.h works on, the same names as in xzoom.c */
+XImage *ximage[2];
+int width[2], height[2];
+int magx, magy;
+int flipxy, flipx, flipy;
+int gridx, gridy;
+int swap_pixels;
+
+/* pixel24.h draws the cursor too, there is none here */
+#define CURSOR_CLEAR	0
+#define CURSOR_INVERT	2
+int cursor_w = 0, cursor_h = 0;
+unsigned long *cursor_pixels = NULL;
+unsigned char *cursor_mask = NULL;
+
+char *progname;
+
+#include "replicate.h"
+#include "zoom.h"
+
+/* scaling kernels, see kernels.h */
+#define NFIXED		4				/* magx values with their own kernels */
+#define NORIENT		3				/* orientations with their own kernels */
+
+#define ORIENT_NONE	0
+#define ORIENT_X	1
+#define ORIENT_XY	2
+
+int fixed_mags[NFIXED] = { 2, 3, 4, 8 };
+
+#define T unsigned char
+#define REP rep8
+#define SCALE scale8
+#define SCALE_TABLE scale8_table
+#include "kernels.h"
+#undef T
+#undef REP
+#undef SCALE
+#undef SCALE_TABLE
+
+#define T unsigned short
+#define REP rep16
+#define SCALE scale16
+#define SCALE_TABLE scale16_table
+#define MIX blend16
+#include "kernels.h"
+#define BLEND blend16_swapped
+void scale16_bilinear_swapped(int j0, int j1, int i0, int i1)
+#include "fscale.h"
+#undef BLEND
+#undef MIX
+#undef T
+#undef REP
+#undef SCALE
+#undef SCALE_TABLE
+
+#define T unsigned int
+#define REP rep32
+#define SCALE scale32
+#define SCALE_TABLE scale32_table
+#define MIX blend32
+#define MIX_LINE blend_line32
+#include "kernels.h"
+#undef MIX_LINE
+#undef MIX
+#undef T
+#undef REP
+#undef SCALE
+#undef SCALE_TABLE
+
+#include "pixel24.h"
+
+#define MAXLIST		64
+
+/* a list of values given on the command line */
+struct list {
+	int n;
+	int v[MAXLIST];
+};
+
+/* the same for zooms */
+struct zlist {
+	int n;
+	double v[MAXLIST];
+};
+
+char *filter_names[2] = { "nearest", "bilinear" };
+
+/* orientations as the xzoom keys that give them: z is flipxy */
+char *orient_names[8] = { "-", "x", "y", "xy", "z", "zx", "zy", "zxy" };
+
+int use_generic = False;			/* only the generic kernels */
+int byte_order;						/* of the images, see -swap */
+double min_time = 0.05;				/* seconds to time each case */
+int errors = 0;
+
+void
+Usage(void) {
+	fprintf(stderr, "Usage: %s [ args ]\n"
+		"Command line args:\n"
+		"-check           compare all depths, mags 1-16, orientations\n"
+		"                 and grids with the reference, no timing\n"
+		"-depth list      depths to time (8,16,32), 24 is 3 bytes/pixel\n"
+		"-mag list        equal magx and magy to time (1,2,3,4,6,8,12,16)\n"
+		"-magx list       magx values, timed against every -magy\n"
+		"-magy list       magy values, timed against every -magx\n"
+		"-zoom list       equal zoomx and zoomy instead, like 1.25,1.5\n"
+		"-filter list     nearest, bilinear or both (nearest)\n"
+		"-orient list     orientations to time: - x y xy z zx zy zxy (all)\n"
+		"-grid list       0: no grid, 1: grid (0,1)\n"
+		"-size list       window sizes to time (256x256,1024x768)\n"
+		"-time seconds    minimum time for each case (0.05)\n"
+		"-generic         use only the generic kernels\n"
+		"-nosimd          use only the plain C replication\n"
+		"-swap            pixels in the other byte order than ours\n"
+		"A list is like 1,2,4 or 1-16 or both mixed.\n",
+		progname);
+	exit(1);
+}
+
+/* parse "1,2,5-8" into l */
+void
+parse_list(struct list *l, char *s) {
+	char *end;
+	int a, b;
+
+	l->n = 0;
+	for(;;) {
+		a = b = strtol(s, &end, 10);
+		if(end == s)
+			Usage();
+		if(*end == '-') {
+			s = end + 1;
+			b = strtol(s, &end, 10);
+			if(end == s || b < a)
+				Usage();
+		}
+		for(; a <= b && l->n < MAXLIST; a++)
+			l->v[l->n++] = a;
+		if(*end != ',')
+			break;
+		s = end + 1;
+	}
+	if(*end || l->n == 0)
+		Usage();
+}
+
+/* parse "1.25,1.5,3" into l */
+void
+parse_zooms(struct zlist *l, char *s) {
+	char *end;
+
+	l->n = 0;
+	for(;;) {
+		if(l->n >= MAXLIST)
+			Usage();
+		l->v[l->n] = strtod(s, &end);
+		if(end == s || l->v[l->n] < 1)
+			Usage();
+		l->n++;
+		if(*end != ',')
+			break;
+		s = end + 1;
+	}
+	if(*end)
+		Usage();
+}
+
+/* parse "256x256,1024x768", widths in w and heights in h */
+void
+parse_sizes(struct list *w, struct list *h, char *s) {
+	char *end;
+
+	w->n = h->n = 0;
+	for(;;) {
+		if(w->n >= MAXLIST)
+			Usage();
+		w->v[w->n] = strtol(s, &end, 10);
+		if(end == s || *end != 'x' || w->v[w->n] < 1)
+			Usage();
+		s = end + 1;
+		h->v[h->n] = strtol(s, &end, 10);
+		if(end == s || h->v[h->n] < 1)
+			Usage();
+		w->n++;
+		h->n++;
+		if(*end != ',')
+			break;
+		s = end + 1;
+	}
+	if(*end)
+		Usage();
+}
+
+/* LSBFirst or MSBFirst, as this machine keeps its words */
+int
+host_byte_order(void) {
+	unsigned int one = 1;
+
+	return *(unsigned char *)&one ? LSBFirst : MSBFirst;
+}
+
+double
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* an XImage like XCreateImage() makes for a ZPixmap, with lines
+   padded to 32 bits, but without asking a server */
+XImage *
+create_image(int depth, int bpp, int w, int h) {
+	XImage *image;
+
+	image = calloc(1, sizeof(XImage));
+	if(image == NULL) {
+		perror("calloc");
+		exit(-1);
+	}
+
+	image->width = w;
+	image->height = h;
+	image->format = ZPixmap;
+	image->byte_order = byte_order;
+	image->bitmap_unit = 32;
+	image->bitmap_bit_order = LSBFirst;
+	image->bitmap_pad = 32;
+	image->depth = depth;
+	image->bits_per_pixel = bpp;
+	image->bytes_per_line = (w * bpp + 31) / 32 * 4;
+	image->data = malloc(image->bytes_per_line * h);
+
+	if(image->data == NULL) {
+		perror("malloc");
+		exit(-1);
+	}
+
+	return image;
+}
+
+void
+destroy_image(XImage *image) {
+	free(image->data);
+	free(image);
+}
+
+/* pixels a byte at a time, in the byte order of the image */
+unsigned int
+get_pixel(XImage *image, int x, int y) {
+	int n = image->bits_per_pixel / 8;
+	unsigned char *p = (unsigned char *)image->data +
+		y * image->bytes_per_line + x * n;
+	unsigned int c = 0;
+	int k;
+
+	for(k = 0; k < n; k++)
+		c = c << 8 | p[image->byte_order == MSBFirst ? k : n - 1 - k];
+	return c;
+}
+
+void
+put_pixel(XImage *image, int x, int y, unsigned int c) {
+	int n = image->bits_per_pixel / 8;
+	unsigned char *p = (unsigned char *)image->data +
+		y * image->bytes_per_line + x * n;
+	int k;
+
+	for(k = 0; k < n; k++, c >>= 8)
+		p[image->byte_order == MSBFirst ? n - 1 - k : k] = c;
+}
+
+/* the source pixel of block (i,j) of DST */
+unsigned int
+block_pixel(int i, int j) {
+	int sx, sy;
+
+	if(flipxy) {
+		sy = flipx ? height[SRC] - 1 - i : i;
+		sx = flipy ? j : width[SRC] - 1 - j;
+	}
+	else {
+		sx = flipx ? width[SRC] - 1 - i : i;
+		sy = flipy ? height[SRC] - 1 - j : j;
+	}
+	return get_pixel(ximage[SRC], sx, sy);
+}
+
+/* for the bilinear filter: the block left of (u + 0.5) / z - 0.5
+   of n blocks, and the weight of the next one */
+int
+bilinear_pos(int u, double z, int n, int *w) {
+	double pos = (u + 0.5) / z - 0.5;
+
+	if(pos < 0)
+		pos = 0;
+	if(pos > n - 1)
+		pos = n - 1;
+	*w = (pos - (int)pos) * 256;
+	return (int)pos;
+}
+
+unsigned int
+blend(unsigned int a, unsigned int b, int w, int bpp) {
+	return bpp == 16 ? blend16(a, b, w) : blend32(a, b, w);
+}
+
+/* what the kernels should make of SRC, one pixel at a time.
+   (u,v) in DST comes from block floor((u + 0.5) / zoomx) across and
+   floor((v + 0.5) / zoomy) down of the scaled (and maybe rotated)
+   source, or with the bilinear filter from the four blocks around
+   it. The grid inverts the last column and line of each block */
+void
+reference(XImage *ref) {
+	int bpp = ref->bits_per_pixel;
+	unsigned int mask = bpp == 32 ? ~0U : (1U << bpp) - 1;
+	unsigned int c, a, b;
+	int nx = flipxy ? height[SRC] : width[SRC];
+	int ny = flipxy ? width[SRC] : height[SRC];
+	int u, v, i, j, i1, j1, wx, wy;
+
+	for(v = 0; v < height[DST]; v++) {
+		for(u = 0; u < width[DST]; u++) {
+			i = floor((u + 0.5) / zoomx);
+			j = floor((v + 0.5) / zoomy);
+			if(filter == FILTER_BILINEAR) {
+				i = bilinear_pos(u, zoomx, nx, &wx);
+				j = bilinear_pos(v, zoomy, ny, &wy);
+				i1 = wx ? i + 1 : i;
+				j1 = wy ? j + 1 : j;
+				a = blend(block_pixel(i, j), block_pixel(i1, j), wx, bpp);
+				b = blend(block_pixel(i, j1), block_pixel(i1, j1), wx, bpp);
+				c = blend(a, b, wy, bpp);
+				i = floor((u + 0.5) / zoomx);
+				j = floor((v + 0.5) / zoomy);
+			}
+			else
+				c = block_pixel(i, j);
+			if(gridy && zoomx >= 2 && floor((u + 1.5) / zoomx) > i)
+				c ^= mask;
+			if(gridx && zoomy >= 2 && floor((v + 1.5) / zoomy) > j)
+				c ^= mask;
+			put_pixel(ref, u, v, c);
+		}
+	}
+}
+
+/* the kernel xzoom would use, see select_kernel() in xzoom.c */
+void (*
+pick_kernel(int bpp))(int, int, int, int) {
+	int m, o, whole = zoomx == magx && zoomy == magy;
+
+	for(m = 0; m < NFIXED && fixed_mags[m] != magx; m++)
+		;
+	if(use_generic)
+		m = NFIXED;
+
+	if(flipxy)
+		o = ORIENT_XY;
+	else if(flipx)
+		o = ORIENT_X;
+	else
+		o = ORIENT_NONE;
+
+	if(bpp == 8)
+		return !whole ? scale8_frac :
+			m < NFIXED ? scale8_table[m][o] : scale8;
+	else if(bpp == 16)
+		return filter == FILTER_BILINEAR ?
+			(swap_pixels ? scale16_bilinear_swapped : scale16_bilinear) :
+			!whole ? scale16_frac :
+			m < NFIXED ? scale16_table[m][o] : scale16;
+	else if(bpp == 24)
+		return scale24;
+	else
+		return filter == FILTER_BILINEAR ? scale32_bilinear :
+			!whole ? scale32_frac :
+			m < NFIXED ? scale32_table[m][o] : scale32;
+}
+
+/* set up SRC and DST for a window of w x h, like resize() in xzoom.c
+   but without clipping DST to the window. Returns the number of
+   lines the kernel loops over */
+int
+setup(int depth, int w, int h) {
+	int bpp = depth <= 8 ? 8 : depth <= 16 ? 16 : depth == 24 ? 24 : 32;
+	unsigned int r = 12345;
+	int x, y;
+
+	if(flipxy) {
+		height[SRC] = ceil(w / zoomx);
+		width[SRC] = ceil(h / zoomy);
+		width[DST] = zoom_start(height[SRC], zoomx);
+		height[DST] = zoom_start(width[SRC], zoomy);
+	}
+	else {
+		width[SRC] = ceil(w / zoomx);
+		height[SRC] = ceil(h / zoomy);
+		width[DST] = zoom_start(width[SRC], zoomx);
+		height[DST] = zoom_start(height[SRC], zoomy);
+	}
+
+	ximage[SRC] = create_image(depth, bpp, width[SRC], height[SRC]);
+	ximage[DST] = create_image(depth, bpp, width[DST], height[DST]);
+
+	/* xzoom has no bilinear filter for 8 or 24 bit pixels either */
+	if(bpp == 8 || bpp == 24)
+		filter = FILTER_NEAREST;
+	swap_pixels = bpp > 8 && byte_order != host_byte_order();
+	zoom_tables();
+
+	/* the same pseudo random source every time */
+	for(y = 0; y < height[SRC]; y++)
+		for(x = 0; x < width[SRC]; x++) {
+			r = r * 1103515245 + 12345;
+			put_pixel(ximage[SRC], x, y, r ^ (r >> 16));
+		}
+
+	return flipxy ? width[SRC] : height[SRC];
+}
+
+/* compare DST with the reference, complain about the first difference */
+int
+check(int depth) {
+	XImage *ref;
+	int x, y, bytes;
+	int ok = True;
+
+	ref = create_image(depth, ximage[DST]->bits_per_pixel,
+		width[DST], height[DST]);
+	reference(ref);
+
+	bytes = width[DST] * ref->bits_per_pixel / 8;
+	for(y = 0; y < height[DST] && ok; y++) {
+		if(memcmp(ximage[DST]->data + y * ximage[DST]->bytes_per_line,
+				ref->data + y * ref->bytes_per_line, bytes) == 0)
+			continue;
+		for(x = 0; get_pixel(ximage[DST], x, y) == get_pixel(ref, x, y); x++)
+			;
+		fprintf(stderr, "%s: depth %d mag %gx%g %s orient %s grid %d "
+			"src %dx%d: pixel (%d,%d) is %x, should be %x\n",
+			progname, depth, zoomx, zoomy, filter_names[filter],
+			orient_names[flipxy * 4 + flipy * 2 + flipx], gridx,
+			width[SRC], height[SRC], x, y,
+			get_pixel(ximage[DST], x, y), get_pixel(ref, x, y));
+		ok = False;
+		errors++;
+	}
+
+	destroy_image(ref);
+	return ok;
+}
+
+void
+set_case(double zx, double zy, int f, int orient, int grid) {
+	zoomx = zx;
+	zoomy = zy;
+	magx = zx;
+	magy = zy;
+	filter = f;
+	flipx = (orient & 1) != 0;
+	flipy = (orient & 2) != 0;
+	flipxy = (orient & 4) != 0;
+	gridx = gridy = grid;
+}
+
+/* check one case with a window of about 67 x 5 source pixels: wide
+   enough for the vector loops of replicate.h and not ending on a
+   whole pixel. It is scaled all across, then again into a cleared
+   DST in three groups of columns, the middle one last so that it
+   shows if one of them stores past its columns */
+void
+check_case(int depth) {
+	void (*kernel)(int, int, int, int);
+	int lines, a, b;
+
+	lines = setup(depth, 67 * zoomx + zoomx / 2, 5 * zoomy + zoomy / 2);
+	kernel = pick_kernel(ximage[DST]->bits_per_pixel);
+	kernel(0, lines, 0, nblock_x);
+	if(check(depth)) {
+		a = nblock_x / 3;
+		b = nblock_x - a;
+		memset(ximage[DST]->data, 0,
+			ximage[DST]->bytes_per_line * ximage[DST]->height);
+		kernel(0, lines, 0, a);
+		kernel(0, lines, b, nblock_x);
+		kernel(0, lines, a, b);
+		check(depth);
+	}
+	destroy_image(ximage[SRC]);
+	destroy_image(ximage[DST]);
+}
+
+/* compare all depths, mags 1 to 16, orientations and grids, then
+   every zoom '+' steps through against a few others, with both
+   filters, then those again with the pixels in the other byte order */
+void
+check_all(void) {
+	int depths[4] = { 8, 16, 24, 32 };
+	double zys[6] = { 1, 1.25, 1.75, 2.5, 3, 7 };
+	int d, mx, my, zx, zy, f, orient, grid, swap, cases = 0;
+
+	for(d = 0; d < 4; d++)
+	for(mx = 1; mx <= 16; mx++)
+	for(my = 1; my <= 16; my++)
+	for(orient = 0; orient < 8; orient++)
+	for(grid = 0; grid < 2; grid++) {
+		set_case(mx, my, FILTER_NEAREST, orient, grid);
+		check_case(depths[d]);
+		cases++;
+	}
+
+	for(swap = 0; swap < 2; swap++)
+	for(d = swap; d < 4; d++)
+	for(zx = 0; zx < NZOOMS; zx++)
+	for(zy = 0; zy < 6; zy++)
+	for(f = 0; f < 2; f++)
+	for(orient = 0; orient < 8; orient++)
+	for(grid = 0; grid < 2; grid++) {
+		byte_order = host_byte_order() ^ swap;
+		set_case(zoom_steps[zx], zys[zy], f, orient, grid);
+		check_case(depths[d]);
+		cases++;
+	}
+	byte_order = host_byte_order();
+
+	printf("%d cases checked, %d failed\n", cases, errors);
+}
+
+/* time one case, scaling the whole image over and over */
+void
+bench(int depth, int w, int h) {
+	void (*kernel)(int, int, int, int);
+	double t0, t;
+	long long n, frames = 0;
+	int lines, ok;
+	double pixels, bytes;
+
+	lines = setup(depth, w, h);
+	kernel = pick_kernel(ximage[DST]->bits_per_pixel);
+
+	kernel(0, lines, 0, nblock_x);	/* warm up the caches */
+	ok = check(depth);
+
+	n = 1;
+	t0 = now();
+	for(;;) {
+		long long k;
+
+		for(k = 0; k < n; k++)
+			kernel(0, lines, 0, nblock_x);
+		frames += n;
+		t = now() - t0;
+		if(t >= min_time)
+			break;
+		n *= 2;
+	}
+
+	pixels = (double)width[DST] * height[DST] * frames;
+	bytes = pixels * ximage[DST]->bits_per_pixel / 8;
+	printf("%5d %5g %5g %-8s %-6s %4d %5d %6d %10.1f %10.1f %s\n",
+		depth, zoomx, zoomy, filter_names[filter],
+		orient_names[flipxy * 4 + flipy * 2 + flipx],
+		gridx, width[DST], height[DST],
+		pixels / t / 1e6, bytes / t / 1e6, ok ? "ok" : "FAIL");
+	fflush(stdout);
+
+	destroy_image(ximage[SRC]);
+	destroy_image(ximage[DST]);
+}
+
+int
+main(int argc, char **argv) {
+	struct list depths = { 3, { 8, 16, 32 } };
+	struct list magxs = { 8, { 1, 2, 3, 4, 6, 8, 12, 16 } };
+	struct list magys = { 0 };		/* empty: same as magx */
+	struct zlist zooms = { 0 };		/* instead of magx and magy */
+	struct list filters = { 1, { FILTER_NEAREST } };
+	struct list orients = { 8, { 0, 1, 2, 3, 4, 5, 6, 7 } };
+	struct list grids = { 2, { 0, 1 } };
+	struct list widths = { 2, { 256, 1024 } };
+	struct list heights = { 2, { 256, 768 } };
+	int check_only = False;
+	int d, mx, my, o, g, s, n, f;
+	char *p;
+
+	progname = argv[0];
+	init_replicate();
+	byte_order = host_byte_order();
+
+	while(--argc > 0) {
+		++argv;
+
+		if(argv[0][0] != '-')
+			Usage();
+
+		if(!strcmp(argv[0], "-check"))
+			check_only = True;
+		else if(!strcmp(argv[0], "-generic"))
+			use_generic = True;
+		else if(!strcmp(argv[0], "-swap"))
+			byte_order = !host_byte_order();
+		else if(!strcmp(argv[0], "-nosimd")) {
+			rep8 = rep8_c;
+			rep16 = rep16_c;
+			rep32 = rep32_c;
+			dup_line = dup_line_c;
+			inv_line = inv_line_c;
+			blend_line32 = blend_line32_c;
+			rep_simd = False;
+		}
+		else if(argc < 2)
+			Usage();
+		else if(!strcmp(argv[0], "-depth")) {
+			parse_list(&depths, argv[1]);
+			for(n = 0; n < depths.n; n++)
+				if(depths.v[n] < 1 || depths.v[n] > 32)
+					Usage();
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-mag")) {
+			parse_list(&magxs, argv[1]);
+			magys.n = 0;
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-magx")) {
+			parse_list(&magxs, argv[1]);
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-magy")) {
+			parse_list(&magys, argv[1]);
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-zoom")) {
+			parse_zooms(&zooms, argv[1]);
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-filter")) {
+			filters.n = 0;
+			for(p = strtok(argv[1], ","); p; p = strtok(NULL, ",")) {
+				for(f = 0; f < 2 && strcmp(p, filter_names[f]); f++)
+					;
+				if(f == 2)
+					Usage();
+				filters.v[filters.n++] = f;
+			}
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-orient")) {
+			p = strtok(argv[1], ",");
+
+			orients.n = 0;
+			for(; p; p = strtok(NULL, ",")) {
+				for(o = 0; o < 8 && strcmp(p, orient_names[o]); o++)
+					;
+				if(o == 8)
+					Usage();
+				orients.v[orients.n++] = o;
+			}
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-grid")) {
+			parse_list(&grids, argv[1]);
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-size")) {
+			parse_sizes(&widths, &heights, argv[1]);
+			--argc; ++argv;
+		}
+		else if(!strcmp(argv[0], "-time")) {
+			min_time = atof(argv[1]);
+			--argc; ++argv;
+		}
+		else
+			Usage();
+	}
+
+	for(n = 0; n < magxs.n; n++)
+		if(magxs.v[n] < 1)
+			Usage();
+	for(n = 0; n < magys.n; n++)
+		if(magys.v[n] < 1)
+			Usage();
+
+	if(check_only) {
+		check_all();
+		return errors ? 1 : 0;
+	}
+
+	printf("# replication: %s, kernels: %s\n",
+		rep_simd ? "vector" : "C", use_generic ? "generic" : "fixed magx");
+	printf("%5s %5s %5s %-8s %-6s %4s %5s %6s %10s %10s %s\n",
+		"depth", "magx", "magy", "filter", "orient", "grid", "width",
+		"height", "Mpixel/s", "MB/s", "check");
+
+	/* with -zoom the zooms are the magx list and there is no magy */
+	if(zooms.n) {
+		magxs.n = zooms.n;
+		magys.n = 0;
+	}
+
+	for(d = 0; d < depths.n; d++)
+	for(s = 0; s < widths.n; s++)
+	for(mx = 0; mx < magxs.n; mx++)
+	for(my = 0; my < (magys.n ? magys.n : 1); my++)
+	for(f = 0; f < filters.n; f++)
+	for(o = 0; o < orients.n; o++)
+	for(g = 0; g < grids.n; g++) {
+		if(zooms.n)
+			set_case(zooms.v[mx], zooms.v[mx], filters.v[f],
+				orients.v[o], grids.v[g] != 0);
+		else
+			set_case(magxs.v[mx], magys.n ? magys.v[my] : magxs.v[mx],
+				filters.v[f], orients.v[o], grids.v[g] != 0);
+		bench(depths.v[d], widths.v[s], heights.v[s]);
+	}
+
+	return errors ? 1 : 0;
+}
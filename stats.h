@@ -0,0 +1,204 @@
+/* per stage timing of the main loop.
+
+   Enabled with -stats file. Every stage of a frame is timed and the
+   times go into a histogram with STAT_STEPS buckets per power of two
+   microseconds, so min, average, p99 and max can be reported for
+   each stage. The statistics are appended to the file on SIGUSR1,
+   every -stats-interval seconds and at exit, as one JSON object per
+   line, or as CSV lines if the file name ends in .csv. */
+
+enum {
+	ST_POINTER,						/* XQueryPointer */
+	ST_EVENTS,						/* handling the event queue */
+	ST_GRAB,						/* getting the source image */
+	ST_SCALE,						/* comparing and scaling */
+	ST_CURSOR,						/* drawing the cursor */
+	ST_PUT,							/* putting the image */
+	ST_FLUSH,						/* XFlush, XSync with -render */
+	ST_FRAME,						/* a whole update */
+	ST_LATENCY,						/* from the grab to the put, -pipeline */
+	NSTAGES
+};
+
+char *stage_names[NSTAGES] = {
+	"pointer", "events", "grab", "scale", "cursor", "put", "flush", "frame",
+	"latency"
+};
+
+#define STAT_STEPS		4			/* buckets per power of two */
+#define STAT_BUCKETS	(32 * STAT_STEPS)
+
+struct stage {
+	long long n;					/* number of samples */
+	long long sum, min, max;		/* nanoseconds */
+	unsigned int hist[STAT_BUCKETS];
+} stages[NSTAGES];
+
+char *stats_name = NULL;			/* where the statistics go */
+int stats_interval = 0;				/* seconds between writes, 0: never */
+long long stats_start;				/* when we started, usec */
+long long stats_next = 0;			/* time of the next periodic write */
+volatile sig_atomic_t stats_signal = False;	/* got SIGUSR1 */
+long long frames_dropped = 0;		/* grabbed but never shown */
+
+/* time a stage: STAT_START(t) ... STAT_STOP(stage, t) */
+#define STAT_START(t) \
+	do { if(stats_name) t = now_nsec(); } while(0)
+#define STAT_STOP(s, t) \
+	do { if(stats_name) stat_add(s, now_nsec() - t); } while(0)
+
+long long
+now_nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* bucket b holds times below 2^(b/STAT_STEPS) microseconds */
+int
+stat_bucket(long long ns) {
+	double us = ns / 1000.0;
+	int b;
+
+	if(us <= 1)
+		return 0;
+	b = log2(us) * STAT_STEPS + 1;
+	return b < STAT_BUCKETS ? b : STAT_BUCKETS - 1;
+}
+
+double
+stat_bucket_limit(int b) {
+	return exp2((double)b / STAT_STEPS);
+}
+
+void
+stat_add(int s, long long ns) {
+	struct stage *st = &stages[s];
+
+	if(st->n == 0 || ns < st->min)
+		st->min = ns;
+	if(ns > st->max)
+		st->max = ns;
+	st->sum += ns;
+	st->n++;
+	st->hist[stat_bucket(ns)]++;
+}
+
+/* 99th percentile in microseconds, as the upper limit of its bucket */
+double
+stat_p99(struct stage *st) {
+	long long k = 0;
+	int b;
+
+	for(b = 0; b < STAT_BUCKETS; b++) {
+		k += st->hist[b];
+		if(k * 100 >= st->n * 99)
+			break;
+	}
+	return stat_bucket_limit(b) < st->max / 1000.0 ?
+		stat_bucket_limit(b) : st->max / 1000.0;
+}
+
+void
+stats_write(void) {
+	struct stage *st;
+	FILE *f;
+	int s, csv;
+	long pos;
+	double elapsed;
+
+	if(!stats_name)
+		return;
+
+	if(!strcmp(stats_name, "-"))
+		f = stderr;
+	else if(!(f = fopen(stats_name, "a"))) {
+		perror(stats_name);
+		return;
+	}
+
+	csv = strlen(stats_name) > 4 &&
+		!strcmp(stats_name + strlen(stats_name) - 4, ".csv");
+	elapsed = (now_usec() - stats_start) / 1e6;
+	pos = ftell(f);
+
+	if(csv) {
+		if(pos <= 0)
+			fprintf(f, "time,backend,width,height,magx,magy,depth,dropped,"
+				"stage,count,min_us,avg_us,p99_us,max_us\n");
+		for(s = 0; s < NSTAGES; s++) {
+			st = &stages[s];
+			fprintf(f, "%.3f,%s,%d,%d,%g,%g,%d,%lld,"
+				"%s,%lld,%.1f,%.1f,%.1f,%.1f\n",
+				elapsed, backend_name(), width[DST], height[DST],
+				zoomx, zoomy, depth, frames_dropped, stage_names[s], st->n,
+				st->min / 1000.0,
+				st->n ? st->sum / 1000.0 / st->n : 0.0,
+				stat_p99(st), st->max / 1000.0);
+		}
+	}
+	else {
+		fprintf(f, "{\"time\": %.3f, \"backend\": \"%s\", "
+			"\"width\": %d, \"height\": %d, \"magx\": %g, \"magy\": %g, "
+			"\"depth\": %d, \"dropped\": %lld, \"stages\": {",
+			elapsed, backend_name(), width[DST], height[DST], zoomx, zoomy,
+			depth, frames_dropped);
+		for(s = 0; s < NSTAGES; s++) {
+			st = &stages[s];
+			fprintf(f, "%s\"%s\": {\"count\": %lld, \"min_us\": %.1f, "
+				"\"avg_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}",
+				s ? ", " : "", stage_names[s], st->n,
+				st->min / 1000.0,
+				st->n ? st->sum / 1000.0 / st->n : 0.0,
+				stat_p99(st), st->max / 1000.0);
+		}
+		fprintf(f, "}}\n");
+	}
+
+	if(f != stderr)
+		fclose(f);
+}
+
+void
+stats_sigusr1(int signum) {
+	stats_signal = True;
+	(void)signum;
+}
+
+/* write the statistics when asked for, or when it is time to */
+void
+stats_check(void) {
+	if(!stats_name)
+		return;
+
+	if(stats_signal) {
+		stats_signal = False;
+		stats_write();
+	}
+
+	if(stats_interval > 0 && now_usec() >= stats_next) {
+		stats_next = now_usec() + stats_interval * 1000000LL;
+		stats_write();
+	}
+}
+
+void
+init_stats(void) {
+	struct sigaction sa;
+
+	if(!stats_name)
+		return;
+
+	stats_start = now_usec();
+	if(stats_interval > 0)
+		stats_next = stats_start + stats_interval * 1000000LL;
+
+	/* no SA_RESTART, the signal has to wake up poll() */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stats_sigusr1;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+
+	atexit(stats_write);
+}
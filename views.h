@@ -0,0 +1,220 @@
+/* several magnifier windows in one process, see -view.
+
+   Every window is a view with its own source area, magnification,
+   orientation, images and all that goes with them. The functions of
+   xzoom.c work on the view in the globals; use_view() puts the view
+   they worked on back into views[] and loads another one.
+
+   The connection, the pointer, the cursor image, the damage and the
+   frame timer are shared by all views. So is the grab: each frame
+   grab_views() grabs the source areas of the views to update once
+   for every group of overlapping or close areas, and each view of
+   a group scales from its part of that grab, unless each view has a
+   guard band of its own, see band.h. */
+
+#define MAXVIEWS	16
+
+#ifdef XDAMAGE
+/* the guard band of a view, see band.h */
+struct band {
+	XImage *image[2];				/* the band, and the one after it */
+#ifdef XSHM
+	XShmSegmentInfo shminfo[2];
+	size_t size[2];
+#endif
+	int cur;						/* image[cur] is the band */
+	int x0, y0, x1, y1;				/* where it is, nowhere if x1 == x0 */
+	int dx0, dy0, dx1, dy1;			/* damaged since, none if dx1 <= dx0 */
+};
+#endif
+
+struct view {
+	Window win;
+	int set_title;
+	long long title_timeout;
+	int xgrab, ygrab;
+	int src_x, src_y;
+	int magx, magy;
+	double zoomx, zoomy;
+	int filter;
+	int flipxy, flipx, flipy;
+	int xzoom_flag, yzoom_flag;
+	int gridx, gridy;
+	int follow_mouse, show_cursor;
+	int width[2], height[2];
+	XImage *ximage[2];
+	XImage *images[NIMAGES];
+#ifdef XSHM
+	XShmSegmentInfo shminfo[NIMAGES];
+	size_t shm_size[NIMAGES];
+#endif
+	int buffer;
+	int buffer_puts[NBUFFERS];
+	char *stale[NBUFFERS];
+	char *stale_columns[NBUFFERS];
+	int created_images;
+	struct shown shown;
+	int force_update, damaged;
+	int unmapped, buttonpressed;
+	char *prev_src;
+	int prev_valid;
+	int prev_x, prev_y;
+	int buffer_x[NBUFFERS];
+	int buffer_y[NBUFFERS];
+	int cursor_j0, cursor_j1, cursor_dirty;
+	int nblock_x, nblock_y;
+	int *block_x, *block_y;
+	int *col_off0, *col_off1;
+	unsigned char *col_w;
+	int *line_off0, *line_off1;
+	unsigned char *line_w;
+	int tables_bpl;
+	unsigned char *blend_rows;
+	int blend_row_size;
+	void (*scale_kernel)(int j0, int j1, int i0, int i1);
+	void (*cursor_kernel)(int cx, int cy);
+#ifdef XRENDER
+	Pixmap render_pixmap;
+	int render_width, render_height;
+	Picture render_src, render_dst;
+#endif
+	Pixmap rows_pixmap;
+	int rows_width, rows_height;
+
+	/* not in the globals */
+	int update;						/* to be drawn this frame */
+	XImage part;					/* its part of a shared grab */
+#ifdef XDAMAGE
+	struct band band;
+#endif
+	int source_geom_mask;			/* the command line, for open_view() */
+	int dest_geom_mask;
+	int xpos, ypos;
+} views[MAXVIEWS];
+
+int nviews = 1;
+struct view *view = views;			/* the view in the globals */
+
+/* one grab of grab_views(), for one or more views */
+struct grab {
+	int x0, y0, x1, y1;				/* the rectangle on the screen */
+	XImage *image;
+#ifdef XSHM
+	XShmSegmentInfo shminfo;
+	size_t size;
+#endif
+} grabs[MAXVIEWS];
+
+#define VIEW_VAR(x) \
+	if(save) \
+		memcpy(&view->x, &x, sizeof(x)); \
+	else \
+		memcpy(&x, &view->x, sizeof(x))
+
+/* copy the globals into view (save) or back. A new per window
+   global of xzoom.c or zoom.h goes here and into struct view */
+void
+view_vars(int save) {
+	VIEW_VAR(win);
+	VIEW_VAR(set_title);
+	VIEW_VAR(title_timeout);
+	VIEW_VAR(xgrab);
+	VIEW_VAR(ygrab);
+	VIEW_VAR(src_x);
+	VIEW_VAR(src_y);
+	VIEW_VAR(magx);
+	VIEW_VAR(magy);
+	VIEW_VAR(zoomx);
+	VIEW_VAR(zoomy);
+	VIEW_VAR(filter);
+	VIEW_VAR(flipxy);
+	VIEW_VAR(flipx);
+	VIEW_VAR(flipy);
+	VIEW_VAR(xzoom_flag);
+	VIEW_VAR(yzoom_flag);
+	VIEW_VAR(gridx);
+	VIEW_VAR(gridy);
+	VIEW_VAR(follow_mouse);
+	VIEW_VAR(show_cursor);
+	VIEW_VAR(width);
+	VIEW_VAR(height);
+	VIEW_VAR(ximage);
+	VIEW_VAR(images);
+#ifdef XSHM
+	VIEW_VAR(shminfo);
+	VIEW_VAR(shm_size);
+#endif
+	VIEW_VAR(buffer);
+	VIEW_VAR(buffer_puts);
+	VIEW_VAR(stale);
+	VIEW_VAR(stale_columns);
+	VIEW_VAR(created_images);
+	VIEW_VAR(shown);
+	VIEW_VAR(force_update);
+	VIEW_VAR(damaged);
+	VIEW_VAR(unmapped);
+	VIEW_VAR(buttonpressed);
+	VIEW_VAR(prev_src);
+	VIEW_VAR(prev_valid);
+	VIEW_VAR(prev_x);
+	VIEW_VAR(prev_y);
+	VIEW_VAR(buffer_x);
+	VIEW_VAR(buffer_y);
+	VIEW_VAR(cursor_j0);
+	VIEW_VAR(cursor_j1);
+	VIEW_VAR(cursor_dirty);
+	VIEW_VAR(nblock_x);
+	VIEW_VAR(nblock_y);
+	VIEW_VAR(block_x);
+	VIEW_VAR(block_y);
+	VIEW_VAR(col_off0);
+	VIEW_VAR(col_off1);
+	VIEW_VAR(col_w);
+	VIEW_VAR(line_off0);
+	VIEW_VAR(line_off1);
+	VIEW_VAR(line_w);
+	VIEW_VAR(tables_bpl);
+	VIEW_VAR(blend_rows);
+	VIEW_VAR(blend_row_size);
+	VIEW_VAR(scale_kernel);
+	VIEW_VAR(cursor_kernel);
+#ifdef XRENDER
+	VIEW_VAR(render_pixmap);
+	VIEW_VAR(render_width);
+	VIEW_VAR(render_height);
+	VIEW_VAR(render_src);
+	VIEW_VAR(render_dst);
+#endif
+	VIEW_VAR(rows_pixmap);
+	VIEW_VAR(rows_width);
+	VIEW_VAR(rows_height);
+}
+
+#undef VIEW_VAR
+
+/* bring views[] up to date with the globals */
+void
+save_view(void) {
+	view_vars(True);
+}
+
+/* make v the view in the globals */
+void
+use_view(struct view *v) {
+	if(v == view)
+		return;
+	view_vars(True);
+	view = v;
+	view_vars(False);
+}
+
+/* the view with window w, NULL if it is not one of ours */
+struct view *
+window_view(Window w) {
+	struct view *v;
+
+	for(v = views; v < views + nviews; v++)
+		if(v->win == w)
+			return v;
+	return NULL;
+}
@@ -0,0 +1,180 @@
+#!/bin/sh
+# xvfbbench.sh - end to end benchmark of xzoom on a private Xvfb.
+#
+# Builds xzoom, starts an Xvfb for every depth, keeps changing the
+# root window under the source area and runs xzoom with every backend,
+# geometry, magnification and delay. For each run it prints the
+# sustained frames per second, the CPU time per frame of xzoom and
+# of the X server, and the bytes xzoom wrote to the X connection per
+# frame.
+#
+# Frames are counted with -stats, CPU time comes from /proc/<pid>/stat
+# and the bytes from wchar in /proc/<pid>/io (which also counts the
+# few hundred bytes of each -stats write).
+#
+# Everything can be changed from the environment, for example
+#	DEPTHS=24 MAGS="2 8" DURATION=10 ./xvfbbench.sh
+#
+# Needs Xvfb and xsetroot, and the libraries xzoom is linked with.
+
+DISPLAYNUM=${DISPLAYNUM:-99}
+DEPTHS=${DEPTHS:-"8 16 24"}
+GEOMETRIES=${GEOMETRIES:-"256x256 512x512 1024x768"}
+MAGS=${MAGS:-"2 4"}
+DELAYS=${DELAYS:-"0 10 40"}			# milliseconds, -delay
+BACKENDS=${BACKENDS:-"shm xlib"}		# -backend
+WARMUP=${WARMUP:-1}					# seconds before measuring
+DURATION=${DURATION:-5}				# seconds measured
+XZOOM_ARGS=${XZOOM_ARGS:-"-no-follow"}
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+DEFINES=${DEFINES:--DFRAME -DXSHM -DXDAMAGE -DXFIXES -DXRENDER -DXINPUT2}
+LIBS=${LIBS:--lXi -lXrender -lXdamage -lXfixes -lXext -lX11 -lpthread -lrt -lm}
+
+SCREEN=2048x1536					# room for the window beside the source
+
+srcdir=$(dirname "$0")
+tmp=$(mktemp -d /tmp/xvfbbench.XXXXXX) || exit 1
+xvfb_pid=
+paint_pid=
+xzoom_pid=
+
+cleanup() {
+	for pid in $xzoom_pid $paint_pid $xvfb_pid; do
+		kill $pid 2>/dev/null
+		wait $pid 2>/dev/null
+	done
+	rm -rf "$tmp"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+for prog in Xvfb xsetroot; do
+	if ! command -v $prog >/dev/null; then
+		echo "$0: $prog not found" >&2
+		exit 1
+	fi
+done
+
+$CC $CFLAGS $DEFINES -o "$tmp/xzoom" "$srcdir/xzoom.c" $LIBS || exit 1
+
+clk_tck=$(getconf CLK_TCK)
+
+# user + system time of a process, in clock ticks
+cpu_ticks() {
+	awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+# bytes written by a process
+write_bytes() {
+	awk '/^wchar:/ { print $2 }' /proc/$1/io
+}
+
+# ask xzoom for its statistics, print "time frames" from the new line
+snapshot() {
+	lines=$(wc -l < "$tmp/stats")
+	kill -USR1 $xzoom_pid
+	tries=0
+	while [ $(wc -l < "$tmp/stats") -le $lines ] && [ $tries -lt 50 ]; do
+		sleep 0.1
+		tries=$((tries + 1))
+	done
+	tail -n 1 "$tmp/stats" |
+		sed -n 's/^{"time": \([0-9.]*\),.*"frame": {"count": \([0-9]*\),.*/\1 \2/p'
+}
+
+printf "%-6s %5s %-9s %3s %5s %8s %10s %10s %12s\n" \
+	backend depth geometry mag delay fps xzoom_ms server_ms bytes/frame
+
+for depth in $DEPTHS; do
+	Xvfb :$DISPLAYNUM -screen 0 ${SCREEN}x$depth -nolisten tcp \
+		>"$tmp/xvfb.log" 2>&1 &
+	xvfb_pid=$!
+	tries=0
+	while [ ! -S /tmp/.X11-unix/X$DISPLAYNUM ] && [ $tries -lt 50 ]; do
+		sleep 0.1
+		tries=$((tries + 1))
+	done
+	if ! kill -0 $xvfb_pid 2>/dev/null; then
+		echo "$0: Xvfb failed, see below" >&2
+		cat "$tmp/xvfb.log" >&2
+		exit 1
+	fi
+	export DISPLAY=:$DISPLAYNUM
+
+	# new content under the source area all the time
+	(
+		while :; do
+			for color in red green blue white black; do
+				xsetroot -solid $color
+			done
+		done
+	) >/dev/null 2>&1 &
+	paint_pid=$!
+
+	for backend in $BACKENDS; do
+	for geometry in $GEOMETRIES; do
+	for mag in $MAGS; do
+	for delay in $DELAYS; do
+		: > "$tmp/stats"
+		# the window is right of the source area, which is at +0+0
+		"$tmp/xzoom" $XZOOM_ARGS -backend $backend -mag $mag -delay $delay \
+			-source +0+0 -geometry $geometry+1024+0 \
+			-stats "$tmp/stats" >"$tmp/xzoom.log" 2>&1 &
+		xzoom_pid=$!
+		sleep $WARMUP
+
+		if ! kill -0 $xzoom_pid 2>/dev/null; then
+			echo "$0: xzoom failed, see below" >&2
+			cat "$tmp/xzoom.log" >&2
+			exit 1
+		fi
+
+		cpu0=$(cpu_ticks $xzoom_pid)
+		xcpu0=$(cpu_ticks $xvfb_pid)
+		bytes0=$(write_bytes $xzoom_pid)
+		start=$(snapshot)
+
+		sleep $DURATION
+
+		end=$(snapshot)
+		cpu1=$(cpu_ticks $xzoom_pid)
+		xcpu1=$(cpu_ticks $xvfb_pid)
+		bytes1=$(write_bytes $xzoom_pid)
+
+		kill $xzoom_pid
+		wait $xzoom_pid 2>/dev/null
+		xzoom_pid=
+
+		echo "$start $end $cpu0 $cpu1 $xcpu0 $xcpu1 $bytes0 $bytes1" |
+		awk -v b=$backend -v d=$depth -v g=$geometry -v m=$mag \
+			-v dl=$delay -v hz=$clk_tck '
+			NF == 10 {
+				frames = $4 - $2
+				secs = $3 - $1
+				if (frames <= 0 || secs <= 0) {
+					printf "%-6s %5s %-9s %3s %5s %8s\n",
+						b, d, g, m, dl, "0"
+					next
+				}
+				printf "%-6s %5s %-9s %3s %5s %8.1f %10.3f %10.3f %12.0f\n",
+					b, d, g, m, dl, frames / secs,
+					($6 - $5) * 1000 / hz / frames,
+					($8 - $7) * 1000 / hz / frames,
+					($10 - $9) / frames
+			}
+			NF != 10 { printf "%-6s %5s %-9s %3s %5s no statistics\n",
+				b, d, g, m, dl }'
+	done
+	done
+	done
+	done
+
+	kill $paint_pid
+	wait $paint_pid 2>/dev/null
+	paint_pid=
+	kill $xvfb_pid
+	wait $xvfb_pid 2>/dev/null
+	xvfb_pid=
+done
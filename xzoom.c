@@ -35,13 +35,21 @@ Carlos Pantelides       * 2020/04/01
                             with modifications to allow turning this feature ON and OFF
                           Added show cursor in magnifier, do not works with rotations
 */
-#include <assert.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
 #include <sys/types.h>
-#include <sys/signal.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <math.h>
+#include <pthread.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
@@ -50,9 +58,26 @@ Carlos Pantelides       * 2020/04/01
 #ifdef XSHM
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/eventfd.h>
 #include <X11/extensions/XShm.h>
 #endif
 
+#ifdef XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
+#if defined(XDAMAGE) || defined(XFIXES)
+#include <X11/extensions/Xfixes.h>
+#endif
+
+#ifdef XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
+
+#ifdef XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif
+
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 
@@ -61,6 +86,11 @@ Carlos Pantelides       * 2020/04/01
 #include <unistd.h>
 #endif
 
+/* the globals below and those of zoom.h hold the view in the globals,
+   see views.h. Every one that belongs to a window (its source area,
+   zoom, images, tables, pixmaps, title...) must also be listed in
+   view_vars() and struct view, or all the views share it */
+
 Display *dpy;
 Screen *scr;
 Window win;
@@ -78,11 +108,37 @@ Font font;
 struct timeval old_time;
 #endif
 
+#ifdef XDAMAGE
+int damage_event_base, damage_error_base;
+Damage damage = None;				/* damage on the root window */
+XserverRegion damage_region;		/* damage fetched from the server */
+int damage_pending = False;			/* got XDamageNotify since last fetch */
+XRectangle *damage_rects = NULL;	/* what fetch_damage() got */
+int ndamage_rects = 0;
+#endif
+
+#ifdef XRENDER
+int use_render = False;				/* let the server do the scaling */
+Pixmap render_pixmap = None;		/* copy of the source area */
+int render_width, render_height;	/* size of render_pixmap */
+Picture render_src = None;			/* picture of render_pixmap */
+Picture render_dst = None;			/* picture of our window */
+GC invert_gc = NULL;				/* for the grid and the cursor */
+Picture render_cursor = None;		/* picture of the cursor image */
+XRectangle *grid_rects = NULL;		/* the grid, grown as needed */
+int ngrid_rects = 0;				/* room in grid_rects */
+#endif
+
+int server_rows = False;			/* -rows, see rows.h */
+Pixmap rows_pixmap = None;
+int rows_width, rows_height;		/* size of rows_pixmap */
+
 Cursor when_button;
 Cursor crosshair;
 
 char *progname;
 int set_title;
+long long title_timeout = 0;		/* when to restore the title */
 
 #define SRC		0				/* index for source image */
 #define	DST		1				/* index for dest image */
@@ -96,8 +152,9 @@ int set_title;
 
 #define CURSOR_RADIUS 5  /* magnifier cursor radius */
 int xgrab, ygrab;				/* where do we take the picture from */
+int src_x, src_y;				/* where the picture in SRC was taken */
 
-int magx = MAGX;
+int magx = MAGX;				/* whole part of zoomx, for scale.h */
 int magy = MAGY;
 
 int flipxy = False;				/* flip x and y */
@@ -110,100 +167,423 @@ int yzoom_flag = False;			/* next mag change only to magy */
 int gridx = False;
 int gridy = False;
 
+int follow_mouse = False;			/* the source area follows the pointer */
+int show_cursor = True;				/* the pointer is drawn in the image */
+
 int width[2] = { 0, WIDTH };
 int height[2] = { 0, HEIGHT };
 unsigned depth = 0;
+int swap_pixels = False;			/* images not in our byte order */
+
+/* the backends, chosen with -backend or at startup */
+#define BACKEND_AUTO	0			/* shm if the server can, else xlib */
+#define BACKEND_SHM		1			/* images in shared memory */
+#define BACKEND_XLIB	2			/* images sent over the connection */
+#define BACKEND_RENDER	3			/* the server scales, see render_frame() */
+
+int backend = BACKEND_AUTO;
+
+/* with shared memory the server reads DST after XShmPutImage()
+   returns, so we scale into a few DST images in turn and wait for
+   the ShmCompletion of a put before using its image again.
+   XPutImage() copies the data, one image is enough */
+#ifdef XSHM
+#define NBUFFERS	3				/* DST images, at most */
+#else
+#define NBUFFERS	1
+#endif
+#define NIMAGES		(1 + NBUFFERS)	/* SRC and the DST images */
+
+int nbuffers = 1;					/* DST images we use */
+
+#define PUT_HEADER	24				/* bytes of a PutImage request */
 
 #ifdef XSHM
-XShmSegmentInfo shminfo[2];			/* Segment info.  */
+int use_shm = False;				/* the images are in shared memory */
+
+#define SHM_GROW		4			/* segments get 1/SHM_GROW more room */
+#define SHM_HIGH_WATER	(16 << 20)	/* but not above that many bytes */
+
+XShmSegmentInfo shminfo[NIMAGES];	/* Segment info.  */
+size_t shm_size[NIMAGES];			/* bytes in each segment, 0: none */
+int shm_completion;					/* event type of ShmCompletion */
 #endif
-XImage *ximage[2];					/* Ximage struct. */
+XImage *ximage[2];					/* SRC and the DST image in use */
+XImage *images[NIMAGES];			/* SRC, then DST image b at 1 + b */
+int buffer = 0;						/* the DST image in ximage[DST] */
+int buffer_puts[NBUFFERS];			/* puts not completed by the server */
+char *stale[NBUFFERS];				/* lines to scale before it is used */
+char *stale_columns[NBUFFERS];		/* and columns, in all lines */
 
 int created_images = False;
 
-#define NDELAYS 5
+/* what was shown in the last update. If nothing here changes and
+   the source area was not damaged we can skip the update */
+struct shown {
+	int xgrab, ygrab;
+	int width[2], height[2];
+	double zoomx, zoomy;
+	int filter;
+	int flipxy, flipx, flipy;
+	int gridx, gridy;
+	int show_cursor, cursor_x, cursor_y;
+} shown;
+
+int force_update = True;			/* next frame must be redrawn */
+int damaged = True;					/* the source area may have changed */
+int unmapped = True;
+int buttonpressed = False;			/* the source area is being moved */
+
+/* copy of the last grabbed source, to find out which lines changed.
+   Its lines are width[SRC] pixels apart, SRC may be part of a wider
+   grab shared with other views */
+char *prev_src = NULL;
+int prev_valid = False;
+int prev_x, prev_y;					/* src_x, src_y of prev_src and the window */
+int buffer_x[NBUFFERS];				/* and of each DST image */
+int buffer_y[NBUFFERS];
+
+#define NSPANS		8				/* max. rectangles put per frame */
+#define SPAN_GAP	4				/* merge spans closer than that */
+
+/* lines j0 .. j1-1 and columns i0 .. i1-1 of DST to update this
+   frame, in blocks, see zoom.h */
+struct span {
+	int j0, j1;
+	int i0, i1;
+} spans[NSPANS];
+int nspans;
+
+/* the spans to put, while spans are the lines to scale */
+struct span put_spans[NSPANS];
+int nput_spans;
+
+void (*scale_kernel)(int j0, int j1, int i0, int i1);	/* see select_kernel() */
+void (*cursor_kernel)(int cx, int cy);
+
+/* the cursor drawn into DST, see cursor.h. Each pixel of the
+   image is CURSOR_CLEAR, CURSOR_SET to cursor_pixels[] or
+   CURSOR_INVERT */
+#define CURSOR_CLEAR	0
+#define CURSOR_SET		1
+#define CURSOR_INVERT	2
+
+int cursor_w, cursor_h;				/* size of the cursor image */
+int cursor_xhot, cursor_yhot;		/* hot spot in the image */
+unsigned long *cursor_pixels = NULL;	/* pixel values for CURSOR_SET */
+unsigned char *cursor_mask = NULL;
+int cursor_j0 = 0, cursor_j1 = 0;	/* DST lines of the last cursor */
+int cursor_dirty = False;			/* the cursor moved or changed */
+
+/* the pointer is followed with events. XInput2 raw motion only
+   says it moved, then we ask where it is once in the next frame */
+int pointer_moved = True;			/* the pointer moved since the last frame */
+int pointer_query = True;			/* we have to ask where it is */
+#ifdef XINPUT2
+int xi_opcode;						/* of XInputExtension, 0 if we have none */
+#endif
+
+#ifdef XFIXES
+int xfixes_event_base, xfixes_error_base;
+int have_xfixes = False;			/* we can get the cursor image */
+unsigned long cursor_serial = 0;	/* serial of the cursor image we have */
+int cursor_stale = True;			/* the cursor changed since we got it */
+unsigned int *cursor_argb = NULL;	/* the image as the server sent it */
+#endif
+
+/* the spans are split in bands which are scaled by a pool of threads */
+#define MAXTHREADS		64
+#define THREAD_PIXELS	65536		/* less than that is done by main() */
+
+int nthreads = 0;					/* 0: one for each processor */
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+int pool_frame = 0;					/* incremented for each new job */
+int pool_busy = 0;					/* workers still scaling */
 
-int delays[NDELAYS] = { 200000, 100000, 50000, 10000, 0 };
+#define NDELAYS 6
+#define AUTO_DELAY	-1				/* adapt the delay to the targets */
+
+int delays[NDELAYS] = { 200000, 100000, 50000, 10000, 0, AUTO_DELAY };
 int delay_index = 0;
 int delay = 200000;			/* 0.2 second between updates */
 
-void
-timeout_func(int signum) {
-	set_title = True;
-	signum = signum;          /* UNUSED */
-}
+#define MIN_DELAY		1000		/* delay 0 still lets the CPU rest */
+#define TITLE_TIMEOUT	2000000		/* how long the delay is shown */
+
+int frame_timer;					/* timerfd for the next frame */
+long long next_frame = 0;			/* when the next frame is due */
+int frame_due = False;				/* time for a new frame */
+
+/* with AUTO_DELAY the delay is computed from what a frame costs */
+#define DEFAULT_FPS		25			/* targets if none were given */
+#define DEFAULT_CPU		0.5
+
+double target_fps = 0;				/* frames per second */
+double target_cpu = 0;				/* fraction of one processor */
+long long frame_cost = 0;			/* average time of a frame */
+long long frame_cpu = 0;			/* average CPU time of a frame */
+
+#include "zoom.h"
+#include "views.h"
 
 #ifdef FRAME
 #define DRAW_FRAME() \
 	XDrawRectangle(dpy, RootWindowOfScreen(scr), framegc, xgrab, ygrab, width[SRC]-1, height[SRC]-1)
 #endif
 
+#ifdef XSHM
+/* a put from the DST image with this segment is done */
 void
-allocate_images(void) {
-	int i;
+shm_completed(XEvent *event) {
+	XShmCompletionEvent *e = (XShmCompletionEvent *)event;
+	struct view *v;
+	int b;
+
+	for(b = 0; b < nbuffers; b++)
+		if(shminfo[1 + b].shmseg == e->shmseg && buffer_puts[b] > 0)
+			buffer_puts[b]--;
+
+	/* or of another view, see views.h */
+	for(v = views; v < views + nviews; v++)
+		if(v != view)
+			for(b = 0; b < nbuffers; b++)
+				if(v->shminfo[1 + b].shmseg == e->shmseg &&
+				   v->buffer_puts[b] > 0)
+					v->buffer_puts[b]--;
+}
 
-	for(i = 0; i < 2; i++) {
+Bool
+is_shm_completion(Display *display, XEvent *event, XPointer arg) {
+	return event->type == shm_completion;
+}
 
-#ifdef XSHM
-		ximage[i] = XShmCreateImage(dpy,
-			DefaultVisualOfScreen(scr),
-			DefaultDepthOfScreen(scr),
-			ZPixmap, NULL, &shminfo[i],
-			width[i], height[i]);
-
-		if(ximage[i] == NULL) {
-			perror("XShmCreateImage");
-			exit(-1);
+/* make an image of w x h in the segment of info, which holds size
+   bytes. A segment is kept as long as the images fit and is only
+   replaced by a bigger one, with room to grow up to SHM_HIGH_WATER
+   bytes. Bigger segments are given back when they are more than
+   twice what is needed, so the window going back to a normal size
+   does not keep a huge one forever */
+XImage *
+shm_image(Display *d, XShmSegmentInfo *info, size_t *size, int w, int h) {
+	XImage *image;
+	size_t need;
+
+	image = XShmCreateImage(d,
+		DefaultVisual(d, DefaultScreen(d)),
+		DefaultDepth(d, DefaultScreen(d)),
+		ZPixmap, NULL, info, w, h);
+
+	if(image == NULL) {
+		perror("XShmCreateImage");
+		exit(-1);
+	}
+
+	need = (size_t)image->bytes_per_line * image->height;
+
+	if(*size < need || (*size > SHM_HIGH_WATER && *size > 2 * need)) {
+		if(*size > 0) {
+			XShmDetach(d, info);		/* ask X11 to detach shared segment */
+			shmdt(info->shmaddr);		/* detach it ourselves */
 		}
 
-		shminfo[i].shmid = shmget(IPC_PRIVATE,
-			(unsigned int)(ximage[i]->bytes_per_line * ximage[i]->height),
-			IPC_CREAT | 0777);
+		*size = need;
+		if(need < SHM_HIGH_WATER)
+			*size += need / SHM_GROW;
+
+		info->shmid = shmget(IPC_PRIVATE, *size, IPC_CREAT | 0777);
 
-		if(shminfo[i].shmid < 0) {
+		if(info->shmid < 0) {
 			perror("shmget");
 			exit(-1);
 		}
 
-		shminfo[i].shmaddr = (char *)shmat(shminfo[i].shmid, 0, 0);
+		info->shmaddr = (char *)shmat(info->shmid, 0, 0);
 
-		if (shminfo[i].shmaddr == ((char *) -1)) {
+		if (info->shmaddr == ((char *) -1)) {
 			perror("shmat");
 			exit(-1);
 		}
 
 #ifdef DEBUG
-		fprintf(stderr, "new shared memory segment at 0x%08x size %d\n",
-			shminfo[i].shmaddr, ximage[i]->bytes_per_line * ximage[i]->height);
+		fprintf(stderr, "new shared memory segment at %p size %lu\n",
+			info->shmaddr, (unsigned long)*size);
 #endif
 
-		ximage[i]->data = shminfo[i].shmaddr;
-		shminfo[i].readOnly = False;
+		info->readOnly = False;
+
+		XShmAttach(d, info);
+		XSync(d, False);
+
+		shmctl(info->shmid, IPC_RMID, 0);
+	}
+
+	image->data = info->shmaddr;
+	return image;
+}
+
+int shm_failed;
 
-		XShmAttach(dpy, &shminfo[i]);
+int
+shm_error(Display *d, XErrorEvent *e) {
+	shm_failed = True;
+	return 0;
+}
+
+/* see if the server can attach our shared memory. It needs
+   the extension and has to run on this host */
+int
+shm_works(void) {
+	XShmSegmentInfo info;
+	int (*handler)(Display *, XErrorEvent *);
+
+	if(!XShmQueryExtension(dpy))
+		return False;
+
+	info.shmid = shmget(IPC_PRIVATE, 4096, IPC_CREAT | 0777);
+	if(info.shmid < 0)
+		return False;
+
+	info.shmaddr = (char *)shmat(info.shmid, 0, 0);
+	if(info.shmaddr == ((char *) -1)) {
+		shmctl(info.shmid, IPC_RMID, 0);
+		return False;
+	}
+	info.readOnly = False;
+
+	XSync(dpy, False);
+	shm_failed = False;
+	handler = XSetErrorHandler(shm_error);
+	XShmAttach(dpy, &info);
+	XSync(dpy, False);
+	if(!shm_failed) {
+		XShmDetach(dpy, &info);
 		XSync(dpy, False);
+	}
+	XSetErrorHandler(handler);
+
+	shmdt(info.shmaddr);
+	shmctl(info.shmid, IPC_RMID, 0);
+
+	return !shm_failed;
+}
+#endif
+
+/* choose between shared memory and plain Xlib requests,
+   before the first image is made */
+void
+init_backend(void) {
+#ifdef XSHM
+	if(backend != BACKEND_XLIB) {
+		use_shm = shm_works();
+		if(!use_shm)
+			fprintf(stderr, "%s: the X server can not share memory "
+				"with us, using xlib\n", progname);
+	}
 
-		shmctl(shminfo[i].shmid, IPC_RMID, 0);
+	if(use_shm) {
+		nbuffers = NBUFFERS;
+		shm_completion = XShmGetEventBase(dpy) + ShmCompletion;
+	}
 #else
-		char *data;
-		data = malloc(BitmapUnit(dpy) / 8 * width[i] * height[i]);
+	if(backend == BACKEND_SHM)
+		fprintf(stderr, "%s: compiled without XSHM, using xlib\n",
+			progname);
+#endif
+}
+
+char *
+backend_name(void) {
+#ifdef XRENDER
+	if(use_render)
+		return "render";
+#endif
+#ifdef XSHM
+	if(use_shm)
+		return "shm";
+#endif
+	return "xlib";
+}
 
-		ximage[i] = XCreateImage(dpy,
-			DefaultVisualOfScreen(scr),
-			DefaultDepthOfScreen(scr),
-			ZPixmap, 0, data,
-			width[i], height[i], 32, 0);
+/* an image of w x h in memory of our own */
+XImage *
+plain_image(int w, int h) {
+	XImage *image;
 
-		if(ximage[i] == NULL) {
-			perror("XCreateImage");
-			exit(-1);
+	image = XCreateImage(dpy,
+		DefaultVisualOfScreen(scr),
+		DefaultDepthOfScreen(scr),
+		ZPixmap, 0, NULL,
+		w, h, 32, 0);
+
+	if(image == NULL) {
+		perror("XCreateImage");
+		exit(-1);
+	}
+
+	image->data = malloc(image->bytes_per_line * h);
+	return image;
+}
+
+void
+allocate_images(void) {
+	int i, k, b, n, m;
+#ifdef XSHM
+	XEvent event;
+
+	/* the segments are used again, let the server finish
+	   reading them for the puts of the old size first */
+	for(b = 0; b < nbuffers; b++)
+		if(buffer_puts[b] > 0)
+			break;
+	if(b < nbuffers) {
+		XSync(dpy, False);
+		while(XCheckIfEvent(dpy, &event, is_shm_completion, NULL))
+			shm_completed(&event);
+	}
+#endif
+
+	for(i = 0; i < 1 + nbuffers; i++) {
+		k = i == 0 ? SRC : DST;
+
+#ifdef XSHM
+		if(use_shm) {
+			images[i] = shm_image(dpy, &shminfo[i], &shm_size[i],
+				width[k], height[k]);
+			continue;
 		}
+#endif
+
+		images[i] = plain_image(width[k], height[k]);
+	}
 
-#endif /* XSHM */
+	ximage[SRC] = images[0];
+
+	/* every line of every DST image has to be scaled */
+	n = flipxy ? width[SRC] : height[SRC];
+	m = flipxy ? height[SRC] : width[SRC];
+	for(b = 0; b < nbuffers; b++) {
+		stale[b] = realloc(stale[b], n);
+		memset(stale[b], True, n);
+		stale_columns[b] = realloc(stale_columns[b], m);
+		memset(stale_columns[b], False, m);
+		buffer_puts[b] = 0;
+		buffer_x[b] = src_x;
+		buffer_y[b] = src_y;
 	}
+	buffer = 0;
+	ximage[DST] = images[1 + buffer];
+
+	prev_src = realloc(prev_src,
+		width[SRC] * ximage[SRC]->bits_per_pixel / 8 * height[SRC]);
+	prev_valid = False;
+
 	created_images = True;
 }
 
+/* with shared memory only the image structures go, the segments
+   stay for the next allocate_images() */
 void
 destroy_images(void) {
 	int i;
@@ -211,291 +591,2391 @@ destroy_images(void) {
 	if (!created_images)
 		return;
 
-	for(i = 0; i < 2; i++) {
+	for(i = 0; i < 1 + nbuffers; i++) {
 #ifdef XSHM
-		XShmDetach(dpy, &shminfo[i]);	/* ask X11 to detach shared segment */
-		shmdt(shminfo[i].shmaddr);		/* detach it ourselves */
-#else
-		free(ximage[i]->data);
+		if(!use_shm)
 #endif
-		ximage[i]->data = NULL;			/* remove refrence to that address */
-		XDestroyImage(ximage[i]);		/* and destroy image */
+		free(images[i]->data);
+		images[i]->data = NULL;			/* remove refrence to that address */
+		XDestroyImage(images[i]);		/* and destroy image */
 	}
 
 	created_images = False;
 }
 
+#ifdef XDAMAGE
+/* subscribe to damage on the root window. Without XDamage
+   we keep polling the source area every delay */
 void
-Usage(void) {
-	fprintf(stderr, "Usage: %s [ args ]\n"
-		"Command line args:\n"
-		"-display displayname\n"
-		"-mag magnification [ magnification ]\n"
-		"-geometry geometry\n"
-		"-source geometry\n"
-		"-x\n"
-		"-y\n"
-		"-xy\n"
-		"-follow\n"
-		"-no-follow\n"
-		"-cursor\n"
-		"-no-cursor\n\n"
-		"Window commands:\n"
-		"+: Zoom in\n"
-		"-: Zoom out\n"
-		"x: Flip right and left\n"
-		"y: Flip top and bottom\n"
-		"z: Rotate 90 degrees counter-clockwize\n"
-		"w: Next '+' or '-' only change width scaling\n"
-		"h: Next '+' or '-' only change height scaling\n"
-		"f: Turn ON or OFF follow mouse\n"
-		"c: Turn ON or OFF show cursor\n"
-		"d: Change delay between frames\n"
-		"q: Quit\n"
-		"Arrow keys: Scroll in direction of arrow\n"
-		"Mouse button drag: Set top-left corner of viewed area\n",
-		progname);
-	exit(1);
+init_damage(void) {
+	int major, minor;
+
+	if(!XDamageQueryExtension(dpy, &damage_event_base, &damage_error_base) ||
+	   !XDamageQueryVersion(dpy, &major, &minor)) {
+		fprintf(stderr, "%s: no XDamage extension, polling\n", progname);
+		return;
+	}
+
+	damage = XDamageCreate(dpy, RootWindowOfScreen(scr),
+		XDamageReportNonEmpty);
+	damage_region = XFixesCreateRegion(dpy, NULL, 0);
 }
 
-/* resize is called with the dest size.
-   we call it then manification changes or when
-   actual window size is changed */
+/* fetch the damage collected since the last call, once
+   for all views */
 void
-resize(int new_width, int new_height) {
+fetch_damage(void) {
+	if(damage_rects)
+		XFree(damage_rects);
 
-	destroy_images();		/* we can get rid of these */
+	XDamageSubtract(dpy, damage, None, damage_region);
+	damage_rects = XFixesFetchRegion(dpy, damage_region, &ndamage_rects);
+}
 
-	/* find new dimensions for source */
+/* see if any of the damage fetched falls in the source area */
+int
+source_damaged(void) {
+	XRectangle *r = damage_rects;
+	int i;
 
-	if(flipxy) {
-		height[SRC] = (new_width+magx-1) / magx;
-		width[SRC] = (new_height+magy-1) / magy;
-	}
-	else {
-		width[SRC] = (new_width+magx-1) / magx;
-		height[SRC] = (new_height+magy-1) / magy;
-	}
+	for(i = 0; i < ndamage_rects; i++)
+		if(r[i].x < xgrab + width[SRC] &&
+		   r[i].x + r[i].width > xgrab &&
+		   r[i].y < ygrab + height[SRC] &&
+		   r[i].y + r[i].height > ygrab)
+			return True;
 
-	if(width[SRC] < 1)
-		width[SRC] = 1;
-	if(width[SRC] > WidthOfScreen(scr))
-		width[SRC] = WidthOfScreen(scr);
+	return False;
+}
+#endif
 
-	if(height[SRC] < 1)
-		height[SRC] = 1;
-	if(height[SRC] > HeightOfScreen(scr))
-		height[SRC] = HeightOfScreen(scr);
+/* add lines j0 .. j1-1 and columns i0 .. i1-1 of DST to the spans
+   to update, merging with the last span when it has the same columns
+   and is close. When we have too many the last one takes it, with
+   the spans before it which it overlaps then */
+void
+add_area(int j0, int j1, int i0, int i1) {
+	int n = flipxy ? width[SRC] : height[SRC];
+	struct span *p;
+
+	if(j0 < 0)
+		j0 = 0;
+	if(j1 > n)
+		j1 = n;
+	if(i0 < 0)
+		i0 = 0;
+	if(i1 > nblock_x)
+		i1 = nblock_x;
+	if(j0 >= j1 || i0 >= i1)
+		return;
 
-	/* temporary, the dest image may be larger than the
-	   actual window */
-	if(flipxy) {
-		width[DST] = magx * height[SRC];
-		height[DST] = magy * width[SRC];
+	p = &spans[nspans > 0 ? nspans-1 : 0];
+	if(nspans > 0 && p->i0 == i0 && p->i1 == i1 &&
+	   j0 <= p->j1 + SPAN_GAP) {
+		if(j1 > p->j1)
+			p->j1 = j1;
+		if(j0 < p->j0)
+			p->j0 = j0;
+		return;
 	}
-	else {
-		width[DST] = magx * width[SRC];
-		height[DST] = magy * height[SRC];
+
+	if(nspans == NSPANS) {
+		for(;;) {
+			if(j0 < p->j0)
+				p->j0 = j0;
+			if(j1 > p->j1)
+				p->j1 = j1;
+			if(i0 < p->i0)
+				p->i0 = i0;
+			if(i1 > p->i1)
+				p->i1 = i1;
+			if(nspans == 1 || p[-1].j1 <= p->j0)
+				return;
+			j0 = p->j0;
+			j1 = p->j1;
+			i0 = p->i0;
+			i1 = p->i1;
+			nspans--;
+			p--;
+		}
 	}
 
-	allocate_images();		/* allocate new images */
+	spans[nspans].j0 = j0;
+	spans[nspans].j1 = j1;
+	spans[nspans].i0 = i0;
+	spans[nspans].i1 = i1;
+	nspans++;
+}
 
-	/* remember actual window size */
-	if(width[DST] > new_width)
-		width[DST] = new_width;
-	if(height[DST] > new_height)
-		height[DST] = new_height;
+/* add lines j0 .. j1-1 of DST, all across */
+void
+add_span(int j0, int j1) {
+	add_area(j0, j1, 0, nblock_x);
 }
 
+/* add columns i0 .. i1-1 of DST, all the way down */
+void
+add_columns(int i0, int i1) {
+	add_area(0, flipxy ? width[SRC] : height[SRC], i0, i1);
+}
 
-void scale8(void)
-{
-#define T unsigned char
-#include "scale.h"
-#undef T
+/* how many blocks the picture at src_y moved down since
+   it was at y, up if negative */
+int
+line_shift(int y) {
+	return flipy ? src_y - y : y - src_y;
 }
 
+/* the same across: how many blocks the picture at
+   src_x moved right since it was at x */
+int
+column_shift(int x) {
+	return flipx ? src_x - x : x - src_x;
+}
 
-void scale16(void)
-{
-#define T unsigned short
-#include "scale.h"
-#undef T
+/* how many pixels of DST the picture moves along an axis of n
+   blocks, which start at start[] with the weights w[] of the bilinear
+   filter, when it moves s blocks. -1 if they do not fall on blocks
+   again (or on the same weights) or if nothing is left */
+int
+shift_pixels(int s, int n, int *start, unsigned char *w) {
+	int a = s < 0 ? -s : s;
+	int j, v;
+
+	if(a >= n)
+		return -1;
+	for(j = 0; j + a <= n; j++)
+		if(start[j + a] - start[a] != start[j])
+			return -1;
+	if(filter == FILTER_BILINEAR)
+		for(v = start[1]; v < start[n - a - 1]; v++)
+			if(w[v + start[a]] != w[v])
+				return -1;
+	return start[a];
 }
 
+/* how many lines of DST the picture moves when it moves s blocks
+   down, see shift_pixels() */
+int
+shift_lines(int s) {
+	return shift_pixels(s, height[SRC], block_y, line_w);
+}
 
-void scale32(void)
-{
-#define T unsigned int
-#include "scale.h"
-#undef T
+/* and how many columns when it moves s blocks right */
+int
+shift_columns(int s) {
+	return shift_pixels(s, width[SRC], block_x, col_w);
 }
 
-static int _XlibErrorHandler(Display *display, XErrorEvent *event) {
-	fprintf(stderr, "An error occured detecting the mouse position\n");
-	return True;
+/* do f(j0, j1) for the blocks of an axis of n to do again after the
+   picture moved s blocks along it: those which came in and, as the
+   bilinear filter treats the first and the last block apart, those
+   which were or are now at either end */
+void
+moved_blocks(int s, int n, void (*f)(int j0, int j1)) {
+	if(s == 0)
+		return;
+
+	if(s > 0)
+		f(0, s);
+	else
+		f(n + s, n);
+
+	if(filter == FILTER_BILINEAR) {
+		f(s, s + 1);
+		f(n - 1 + s, n + s);
+		f(0, 1);
+		f(n - 1, n);
+	}
 }
 
+/* how many of the n blocks of an axis, which start at start[], are
+   wholly in the first size pixels of the window */
 int
-main(int argc, char **argv) {
-	int follow_mouse = False;
-	int show_cursor = True;
-	int number_of_screens;
-	int i;
-	Bool result;
-	Window *root_windows;
-	Window window_returned;
-	int root_x, root_y;
-	int win_x, win_y;
-	unsigned int mask_return;
-
-	Display *display = XOpenDisplay(NULL);
-	assert(display);
-	XSetErrorHandler(_XlibErrorHandler);
-	number_of_screens = XScreenCount(display);
-	fprintf(stderr, "There are %d screens available in this X session\n", number_of_screens);
-	root_windows = malloc(sizeof(Window) * number_of_screens);
-	for (i = 0; i < number_of_screens; i++) {
-		root_windows[i] = XRootWindow(display, i);
-	}
-	for (i = 0; i < number_of_screens; i++) {
-		result = XQueryPointer(display, root_windows[i], &window_returned,
-				&window_returned, &root_x, &root_y, &win_x, &win_y,
-				&mask_return);
-		if (result == True) {
-			break;
+whole_blocks(int n, int *start, int size) {
+	while(n > 0 && start[n] > size)
+		n--;
+	return n;
+}
+
+/* the source moved since the last frame. When the blocks of DST can
+   follow it the server moves the window contents, prev_src is moved
+   the same way and only the lines and columns which came in are
+   scaled and put, otherwise everything is */
+void
+scroll_window(void) {
+	int sx = column_shift(prev_x);
+	int sy = line_shift(prev_y);
+	int dx = shift_columns(sx);
+	int dy = shift_lines(sy);
+	int e = prev_x - src_x;				/* the same in source pixels */
+	int d = prev_y - src_y;
+	int px = ximage[SRC]->bits_per_pixel / 8;
+	int n = width[SRC] * px;
+	int bpl = ximage[SRC]->bytes_per_line;
+	int w = width[SRC];
+	int h = height[SRC];
+	int j, x0, x1;
+	char *p;
+
+	if(dx < 0 || dy < 0) {
+		force_update = True;
+		return;
+	}
+
+	if(width[DST] > dx && height[DST] > dy)
+		XCopyArea(dpy, win, win, gc, sx > 0 ? 0 : dx, sy > 0 ? 0 : dy,
+			width[DST] - dx, height[DST] - dy,
+			sx > 0 ? dx : 0, sy > 0 ? dy : 0);
+
+	if(d > 0)
+		memmove(prev_src + d * n, prev_src, (h - d) * n);
+	else if(d < 0)
+		memmove(prev_src, prev_src - d * n, (h + d) * n);
+
+	/* the columns which came in are scaled anyway, take them
+	   from SRC so the lines only differ where they changed */
+	if(e != 0) {
+		x0 = e > 0 ? 0 : w + e;
+		x1 = e > 0 ? e : w;
+		for(j = 0; j < h; j++) {
+			p = prev_src + j * n;
+			if(e > 0)
+				memmove(p + e * px, p, (w - e) * px);
+			else
+				memmove(p, p - e * px, (w + e) * px);
+			memcpy(p + x0 * px, ximage[SRC]->data + j * bpl + x0 * px,
+				(x1 - x0) * px);
 		}
 	}
-	if (result != True) {
-		fprintf(stderr, "No mouse found.\n");
-		return -1;
+
+	/* the old cursor went along */
+	cursor_j0 += sy;
+	cursor_j1 += sy;
+
+	moved_blocks(sy, h, add_span);
+	moved_blocks(sx, w, add_columns);
+
+	/* a block which was only partly in the window did not
+	   come along whole */
+	if(sy < 0)
+		add_span(whole_blocks(h, block_y, height[DST]) + sy, h);
+	if(sx < 0)
+		add_columns(whole_blocks(w, block_x, width[DST]) + sx, w);
+}
+
+/* compare the new source with the copy of the previous one and
+   find the lines of DST which have to be updated.
+   with flipxy a source line is a column of DST so we do it all.
+   The bilinear filter mixes each line with the next one, so the
+   blocks next to a changed one change too */
+void
+find_dirty_lines(void) {
+	int bpl = ximage[SRC]->bytes_per_line;
+	int n = width[SRC] * ximage[SRC]->bits_per_pixel / 8;
+	char *p1, *p2;
+	int j;
+
+	nspans = 0;
+
+	if(!force_update && prev_valid && !flipxy &&
+	   (src_x != prev_x || src_y != prev_y))
+		scroll_window();
+	prev_x = src_x;
+	prev_y = src_y;
+
+	if(force_update || !prev_valid || flipxy) {
+		for(j = 0; j < height[SRC]; j++)
+			memcpy(prev_src + j * n, ximage[SRC]->data + j * bpl, n);
+		prev_valid = True;
+		add_span(0, flipxy ? width[SRC] : height[SRC]);
+		return;
 	}
-	printf("Mouse is at (%d,%d)\n", root_x, root_y);
 
-	XSetWindowAttributes xswa;
+	for(j = 0; j < height[SRC]; j++) {
+		int y = flipy ? height[SRC]-1-j : j;
+
+		p1 = ximage[SRC]->data + y * bpl;
+		p2 = prev_src + y * n;
+
+		if(memcmp(p1, p2, n)) {
+			memcpy(p2, p1, n);
+			if(filter == FILTER_BILINEAR)
+				add_span(j-1, j+2);
+			else
+				add_span(j, j+1);
+		}
+	}
+}
+
+/* make the next DST image the server is not reading from the one in
+   ximage[DST], waiting for a ShmCompletion if they are all busy */
+void
+next_buffer(void) {
+#ifdef XSHM
 	XEvent event;
+	int b;
 
-	int buttonpressed = False;
-	int unmapped = True;
-	int scroll = 1;
-	char title[80];
-	XGCValues gcv;
-	char *dpyname = NULL;
-	int source_geom_mask = NoValue,
-		dest_geom_mask = NoValue,
-		copy_from_src_mask;
-	int xpos = 0, ypos = 0;
+	for(;;) {
+		for(b = 1; b <= nbuffers; b++) {
+			if(buffer_puts[(buffer + b) % nbuffers] == 0) {
+				buffer = (buffer + b) % nbuffers;
+				ximage[DST] = images[1 + buffer];
+				return;
+			}
+		}
+		XIfEvent(dpy, &event, is_shm_completion, NULL);
+		shm_completed(&event);
+	}
+#endif
+}
 
-	atexit(destroy_images);
-	progname = strrchr(argv[0], '/');
-	if(progname)
-		++progname;
-	else
-		progname = argv[0];
+/* the blocks in the spans changed, in every DST image. Those are
+   where the picture was when they were last used, see shift_buffer().
+   A span of all lines is stale in its columns, any other in its
+   lines */
+void
+mark_stale(void) {
+	int n = flipxy ? width[SRC] : height[SRC];
+	int b, i, s, t, j0, j1, i0, i1;
+
+	for(b = 0; b < nbuffers; b++) {
+		s = flipxy ? 0 : line_shift(buffer_y[b]);
+		t = flipxy ? 0 : column_shift(buffer_x[b]);
+		for(i = 0; i < nspans; i++) {
+			if(spans[i].j0 == 0 && spans[i].j1 == n &&
+			   spans[i].i1 - spans[i].i0 < nblock_x) {
+				i0 = spans[i].i0 - t;
+				i1 = spans[i].i1 - t;
+				if(i0 < 0)
+					i0 = 0;
+				if(i1 > nblock_x)
+					i1 = nblock_x;
+				if(i0 < i1)
+					memset(stale_columns[b] + i0, True, i1 - i0);
+				continue;
+			}
+			j0 = spans[i].j0 - s;
+			j1 = spans[i].j1 - s;
+			if(j0 < 0)
+				j0 = 0;
+			if(j1 > n)
+				j1 = n;
+			if(j0 < j1)
+				memset(stale[b] + j0, True, j1 - j0);
+		}
+	}
+}
 
-	/* parse command line options */
+/* lines j0 .. j1-1 of the DST image in use are stale */
+void
+stale_lines(int j0, int j1) {
+	int n = height[SRC];
+
+	if(j0 < 0)
+		j0 = 0;
+	if(j1 > n)
+		j1 = n;
+	if(j0 < j1)
+		memset(stale[buffer] + j0, True, j1 - j0);
+}
+
+/* and columns i0 .. i1-1 */
+void
+stale_cols(int i0, int i1) {
+	int n = width[SRC];
+
+	if(i0 < 0)
+		i0 = 0;
+	if(i1 > n)
+		i1 = n;
+	if(i0 < i1)
+		memset(stale_columns[buffer] + i0, True, i1 - i0);
+}
+
+/* move the picture in the DST image in use to where it is now,
+   like scroll_window() did with the window */
+void
+shift_buffer(void) {
+	XImage *image = ximage[DST];
+	char *p = stale[buffer];
+	char *q = stale_columns[buffer];
+	int n = height[SRC];
+	int w = width[SRC];
+	int bpl = image->bytes_per_line;
+	int px = image->bits_per_pixel / 8;
+	int sx, sy, dx, dy, k;
+	char *line;
+
+	if(flipxy || (buffer_x[buffer] == src_x && buffer_y[buffer] == src_y)) {
+		buffer_x[buffer] = src_x;
+		buffer_y[buffer] = src_y;
+		return;
+	}
+
+	sx = column_shift(buffer_x[buffer]);
+	sy = line_shift(buffer_y[buffer]);
+	buffer_x[buffer] = src_x;
+	buffer_y[buffer] = src_y;
+
+	/* not worth it when all of it is scaled again */
+	if(!memchr(p, False, n))
+		return;
+
+	/* with rows a block is one line of the image, see use_rows() */
+	if(server_rows && filter == FILTER_NEAREST)
+		dy = (sy < 0 ? -sy : sy) < n ? (sy < 0 ? -sy : sy) : -1;
+	else
+		dy = shift_lines(sy);
+	dx = shift_columns(sx);
+	if(dx < 0 || dy < 0) {
+		memset(p, True, n);
+		return;
+	}
+
+	if(sy > 0) {
+		memmove(image->data + dy * bpl, image->data,
+			(image->height - dy) * bpl);
+		memmove(p + sy, p, n - sy);
+	}
+	else if(sy < 0) {
+		memmove(image->data, image->data + dy * bpl,
+			(image->height - dy) * bpl);
+		memmove(p, p - sy, n + sy);
+	}
+	moved_blocks(sy, n, stale_lines);
+
+	if(sx != 0) {
+		for(k = 0; k < image->height; k++) {
+			line = image->data + k * bpl;
+			if(sx > 0)
+				memmove(line + dx * px, line, (image->width - dx) * px);
+			else
+				memmove(line, line + dx * px, (image->width - dx) * px);
+		}
+		if(sx > 0)
+			memmove(q + sx, q, w - sx);
+		else
+			memmove(q, q - sx, w + sx);
+		moved_blocks(sx, w, stale_cols);
+	}
+}
+
+/* replace the spans by the stale blocks of the DST image in use,
+   which are not stale any more when they are scaled. Stale lines
+   are done all across, the stale columns in the lines between */
+void
+stale_spans(void) {
+	int n = flipxy ? width[SRC] : height[SRC];
+	char *p = stale[buffer];
+	char *q = stale_columns[buffer];
+	int cols = memchr(q, True, nblock_x) != NULL;
+	int i, i0, j, j0;
+
+	nspans = 0;
+	for(j = 0; j < n; ) {
+		for(j0 = j; j < n && p[j]; j++)
+			p[j] = False;
+		add_span(j0, j);
+
+		for(j0 = j; j < n && !p[j]; j++)
+			;
+		for(i = 0; cols && i < nblock_x; ) {
+			for(; i < nblock_x && !q[i]; i++)
+				;
+			for(i0 = i; i < nblock_x && q[i]; i++)
+				;
+			add_area(j0, j, i0, i);
+		}
+	}
+	memset(q, False, nblock_x);
+}
+
+/* without XFixes the cursor is the outline of a box, which
+   inverts what is under it */
+void
+box_cursor(void) {
+	int n = 2 * CURSOR_RADIUS + 1;
+	int x, y;
+
+	cursor_w = cursor_h = n;
+	cursor_xhot = cursor_yhot = CURSOR_RADIUS;
+	cursor_pixels = realloc(cursor_pixels, n * n * sizeof(unsigned long));
+	cursor_mask = realloc(cursor_mask, n * n);
+
+	for(y = 0; y < n; y++)
+		for(x = 0; x < n; x++) {
+			cursor_pixels[y * n + x] = 0;
+			cursor_mask[y * n + x] =
+				x == 0 || y == 0 || x == n - 1 || y == n - 1 ?
+				CURSOR_INVERT : CURSOR_CLEAR;
+		}
+}
+
+#ifdef XFIXES
+/* one 8 bit channel as bits of a pixel */
+unsigned long
+channel(unsigned int c, unsigned long mask) {
+	int shift = 0, bits = 0;
+
+	if(!mask)
+		return 0;
+	while(!(mask & 1)) {
+		mask >>= 1;
+		shift++;
+	}
+	while(mask & 1) {
+		mask >>= 1;
+		bits++;
+	}
+	c = bits <= 8 ? c >> (8 - bits) : c << (bits - 8);
+	return (unsigned long)c << shift;
+}
+
+/* the pixel of the default visual for a premultiplied ARGB pixel.
+   Without a true color visual there is black and white */
+unsigned long
+argb_pixel(unsigned int argb) {
+	Visual *visual = DefaultVisualOfScreen(scr);
+	unsigned int a = argb >> 24;
+	unsigned int r = (argb >> 16) & 0xff;
+	unsigned int g = (argb >> 8) & 0xff;
+	unsigned int b = argb & 0xff;
+
+	if(a > 0 && a < 0xff) {
+		r = r * 0xff / a;
+		g = g * 0xff / a;
+		b = b * 0xff / a;
+	}
+
+	if(visual->class == TrueColor || visual->class == DirectColor)
+		return channel(r, visual->red_mask) |
+			channel(g, visual->green_mask) |
+			channel(b, visual->blue_mask);
+
+	return r * 30 + g * 59 + b * 11 >= 128 * 100 ?
+		WhitePixelOfScreen(scr) : BlackPixelOfScreen(scr);
+}
+#endif
+
+/* get the cursor image, and ask to be told when it changes */
+void
+init_cursor(void) {
+#ifdef XFIXES
+	int major, minor;
+#endif
+
+	box_cursor();
+
+#ifdef XFIXES
+	if(!XFixesQueryExtension(dpy, &xfixes_event_base, &xfixes_error_base) ||
+	   !XFixesQueryVersion(dpy, &major, &minor)) {
+		fprintf(stderr, "%s: no XFixes extension, the cursor is a box\n",
+			progname);
+		return;
+	}
+
+	XFixesSelectCursorInput(dpy, RootWindowOfScreen(scr),
+		XFixesDisplayCursorNotifyMask);
+	have_xfixes = True;
+	cursor_stale = True;
+#endif
+}
+
+#ifdef XFIXES
+/* fetch the cursor image if it changed since we did last time.
+   Pixels less than half transparent are drawn, the rest not */
+void
+load_cursor(void) {
+	XFixesCursorImage *image;
+	int i, n;
+
+	if(!have_xfixes || !cursor_stale)
+		return;
+	cursor_stale = False;
+
+	if(!(image = XFixesGetCursorImage(dpy)))
+		return;
+
+	n = image->width * image->height;
+	cursor_w = image->width;
+	cursor_h = image->height;
+	cursor_xhot = image->xhot;
+	cursor_yhot = image->yhot;
+	cursor_serial = image->cursor_serial;
+	cursor_pixels = realloc(cursor_pixels, n * sizeof(unsigned long));
+	cursor_mask = realloc(cursor_mask, n);
+	cursor_argb = realloc(cursor_argb, n * sizeof(unsigned int));
+
+	for(i = 0; i < n; i++) {
+		cursor_argb[i] = image->pixels[i];
+		if((cursor_argb[i] >> 24) < 0x80) {
+			cursor_mask[i] = CURSOR_CLEAR;
+			cursor_pixels[i] = 0;
+		}
+		else {
+			cursor_mask[i] = CURSOR_SET;
+			cursor_pixels[i] = argb_pixel(cursor_argb[i]);
+		}
+	}
+
+	XFree(image);
+
+#ifdef XRENDER
+	if(render_cursor != None) {
+		XRenderFreePicture(dpy, render_cursor);
+		render_cursor = None;
+	}
+#endif
+}
+#endif
+
+/* ask to be told when the pointer moves. XInput2 raw motion comes
+   wherever the pointer is. Without it we get motion on the root
+   window, but not while the pointer is in a window of a client
+   which asked for motion itself */
+void
+init_pointer(void) {
+#ifdef XINPUT2
+	int event, error, major = 2, minor = 0;
+	unsigned char bits[XIMaskLen(XI_LASTEVENT)];
+	XIEventMask mask;
+
+	if(XQueryExtension(dpy, "XInputExtension", &xi_opcode, &event, &error) &&
+	   XIQueryVersion(dpy, &major, &minor) == Success) {
+		memset(bits, 0, sizeof(bits));
+		XISetMask(bits, XI_RawMotion);
+		mask.deviceid = XIAllMasterDevices;
+		mask.mask_len = sizeof(bits);
+		mask.mask = bits;
+		XISelectEvents(dpy, RootWindowOfScreen(scr), &mask, 1);
+		return;
+	}
+	xi_opcode = 0;
+	fprintf(stderr, "%s: no XInput2 extension, using motion events\n",
+		progname);
+#endif
+	XSelectInput(dpy, RootWindowOfScreen(scr), PointerMotionMask);
+}
+
+/* ask the server where the pointer is. The old position
+   is kept while the pointer is on another screen */
+void
+query_pointer(int *x, int *y) {
+	Window root, child;
+	int root_x, root_y, win_x, win_y;
+	unsigned int mask;
+
+	if(XQueryPointer(dpy, RootWindowOfScreen(scr), &root, &child,
+			&root_x, &root_y, &win_x, &win_y, &mask)) {
+		*x = root_x;
+		*y = root_y;
+	}
+}
+
+/* trying XShmGetImage when part of the rect is
+   not on the screen will fail LOUDLY..
+   we have to veryfy this after anything that may
+   may modified xgrab or ygrab or the size of
+   the source ximage */
+void
+clamp_grab(void) {
+	if(xgrab < 0)
+		xgrab = 0;
+
+	if(xgrab > WidthOfScreen(scr)-width[SRC])
+		xgrab =  WidthOfScreen(scr)-width[SRC];
+
+	if(ygrab < 0)
+		ygrab = 0;
+
+	if(ygrab > HeightOfScreen(scr)-height[SRC])
+		ygrab = HeightOfScreen(scr)-height[SRC];
+}
+
+/* the blocks of DST the cursor covers: columns i0 .. i1-1 in units
+   and lines j0 .. j1-1 in blocks, see zoom.h. Not clipped */
+void
+cursor_blocks(int root_x, int root_y, int *i0, int *i1, int *j0, int *j1) {
+	int x0 = root_x - cursor_xhot - src_x;
+	int y0 = root_y - cursor_yhot - src_y;
+	int x1 = x0 + cursor_w;
+	int y1 = y0 + cursor_h;
+
+	if(flipxy) {
+		*i0 = flipx ? height[SRC] - y1 : y0;
+		*i1 = flipx ? height[SRC] - y0 : y1;
+		*j0 = flipy ? x0 : width[SRC] - x1;
+		*j1 = flipy ? x1 : width[SRC] - x0;
+	}
+	else {
+		*i0 = flipx ? width[SRC] - x1 : x0;
+		*i1 = flipx ? width[SRC] - x0 : x1;
+		*j0 = flipy ? height[SRC] - y1 : y0;
+		*j1 = flipy ? height[SRC] - y0 : y1;
+	}
+}
+
+#ifdef XRENDER
+/* set up the render backend. If the server can not
+   do it we go back to scaling ourselves */
+void
+init_render(void) {
+	int event_base, error_base;
+	XRenderPictFormat *fmt;
+	XGCValues gcv;
+
+	if(!XRenderQueryExtension(dpy, &event_base, &error_base) ||
+	   !(fmt = XRenderFindVisualFormat(dpy, DefaultVisualOfScreen(scr)))) {
+		fprintf(stderr, "%s: no RENDER extension, scaling in xzoom\n", progname);
+		use_render = False;
+		return;
+	}
+
+	render_dst = XRenderCreatePicture(dpy, win, fmt, 0, NULL);
+
+	/* the first view makes it for all */
+	if(invert_gc)
+		return;
+	gcv.function = GXinvert;
+	gcv.plane_mask = AllPlanes;
+	invert_gc = XCreateGC(dpy, win, GCFunction|GCPlaneMask, &gcv);
+}
+
+#ifdef XFIXES
+/* put the cursor image into a picture the size of the cursor */
+void
+make_render_cursor(void) {
+	XImage *image;
+	Pixmap pixmap;
+	GC cursor_gc;
+
+	pixmap = XCreatePixmap(dpy, win, cursor_w, cursor_h, 32);
+	cursor_gc = XCreateGC(dpy, pixmap, 0, NULL);
+	image = XCreateImage(dpy, DefaultVisualOfScreen(scr), 32, ZPixmap, 0,
+		(char *)cursor_argb, cursor_w, cursor_h, 32, 0);
+	XPutImage(dpy, pixmap, cursor_gc, image, 0, 0, 0, 0, cursor_w, cursor_h);
+	image->data = NULL;				/* it is cursor_argb */
+	XDestroyImage(image);
+	XFreeGC(dpy, cursor_gc);
+
+	render_cursor = XRenderCreatePicture(dpy, pixmap,
+		XRenderFindStandardFormat(dpy, PictStandardARGB32), 0, NULL);
+	XRenderSetPictureFilter(dpy, render_cursor, FilterNearest, NULL, 0);
+	XFreePixmap(dpy, pixmap);
+}
+#endif
+
+/* copy the source area to render_pixmap on the server and
+   composite it into the window, scaled, flipped and rotated
+   by a transformation. Nothing is sent to or from the server
+   but a few requests */
+void
+render_frame(int show_cursor, int root_x, int root_y) {
+	XTransform t;
+	XRectangle *r;
+	int i, n, w, h;
+
+	if(render_pixmap == None ||
+	   render_width != width[SRC] || render_height != height[SRC]) {
+		if(render_pixmap != None) {
+			XRenderFreePicture(dpy, render_src);
+			XFreePixmap(dpy, render_pixmap);
+		}
+		render_width = width[SRC];
+		render_height = height[SRC];
+		render_pixmap = XCreatePixmap(dpy, win,
+			render_width, render_height, DefaultDepthOfScreen(scr));
+		render_src = XRenderCreatePicture(dpy, render_pixmap,
+			XRenderFindVisualFormat(dpy, DefaultVisualOfScreen(scr)),
+			0, NULL);
+		XRenderSetPictureFilter(dpy, render_src, FilterNearest, NULL, 0);
+	}
+
+	XCopyArea(dpy, RootWindowOfScreen(scr), render_pixmap, gc,
+		xgrab, ygrab, width[SRC], height[SRC], 0, 0);
+
+	/* the transformation maps window coordinates to
+	   coordinates in the source area */
+	memset(&t, 0, sizeof(t));
+	t.matrix[2][2] = XDoubleToFixed(1.0);
+
+	if(flipxy) {
+		/* source x from window y, source y from window x */
+		t.matrix[0][1] = XDoubleToFixed(flipy ? 1.0/zoomy : -1.0/zoomy);
+		t.matrix[0][2] = XDoubleToFixed(flipy ? 0 : width[SRC]);
+		t.matrix[1][0] = XDoubleToFixed(flipx ? -1.0/zoomx : 1.0/zoomx);
+		t.matrix[1][2] = XDoubleToFixed(flipx ? height[SRC] : 0);
+	}
+	else {
+		t.matrix[0][0] = XDoubleToFixed(flipx ? -1.0/zoomx : 1.0/zoomx);
+		t.matrix[0][2] = XDoubleToFixed(flipx ? width[SRC] : 0);
+		t.matrix[1][1] = XDoubleToFixed(flipy ? -1.0/zoomy : 1.0/zoomy);
+		t.matrix[1][2] = XDoubleToFixed(flipy ? height[SRC] : 0);
+	}
+
+	XRenderSetPictureTransform(dpy, render_src, &t);
+	XRenderSetPictureFilter(dpy, render_src,
+		filter == FILTER_BILINEAR ? FilterBilinear : FilterNearest, NULL, 0);
+	XRenderComposite(dpy, PictOpSrc, render_src, None, render_dst,
+		0, 0, 0, 0, 0, 0, width[DST], height[DST]);
+
+	/* the grid is drawn like scale.h does it: the last
+	   column and line of every magnified pixel is inverted */
+	w = flipxy ? height[SRC] : width[SRC];
+	h = flipxy ? width[SRC] : height[SRC];
+	if(w + h > ngrid_rects) {
+		grid_rects = realloc(grid_rects, (w + h) * sizeof(XRectangle));
+		if(!grid_rects) {
+			perror("realloc");
+			exit(-1);
+		}
+		ngrid_rects = w + h;
+	}
+	r = grid_rects;
+	n = 0;
+
+	if(gridy && zoomx >= 2) {
+		for(i = 0; i < w; i++, n++) {
+			r[n].x = block_x[i + 1] - 1;
+			r[n].y = 0;
+			r[n].width = 1;
+			r[n].height = height[DST];
+		}
+	}
+
+	if(gridx && zoomy >= 2) {
+		for(i = 0; i < h; i++, n++) {
+			r[n].x = 0;
+			r[n].y = block_y[i + 1] - 1;
+			r[n].width = width[DST];
+			r[n].height = 1;
+		}
+	}
+
+	if(n > 0)
+		XFillRectangles(dpy, win, invert_gc, r, n);
+
+	if(show_cursor) {
+		XRectangle box[4];
+		int i0, i1, j0, j1;
+		int x0, x1, y0, y1;
+
+		cursor_blocks(root_x, root_y, &i0, &i1, &j0, &j1);
+		x0 = zoom_start(i0, zoomx);
+		x1 = zoom_start(i1, zoomx);
+		y0 = zoom_start(j0, zoomy);
+		y1 = zoom_start(j1, zoomy);
+#ifdef XFIXES
+		load_cursor();
+		if(have_xfixes && cursor_argb) {
+			if(render_cursor == None)
+				make_render_cursor();
+
+			/* the source transformation, moved to the cursor */
+			t.matrix[0][2] -= XDoubleToFixed(root_x - cursor_xhot - xgrab);
+			t.matrix[1][2] -= XDoubleToFixed(root_y - cursor_yhot - ygrab);
+			XRenderSetPictureTransform(dpy, render_cursor, &t);
+			XRenderComposite(dpy, PictOpOver, render_cursor, None, render_dst,
+				x0, y0, 0, 0, x0, y0, x1 - x0, y1 - y0);
+			return;
+		}
+#endif
+		/* the outline of the box cursor */
+		r = box;
+		r[0].x = r[1].x = r[2].x = x0;
+		r[0].y = r[2].y = r[3].y = y0;
+		r[0].width = r[1].width = x1 - x0;
+		r[0].height = r[1].height = zoom_start(j0 + 1, zoomy) - y0;
+		r[1].y = zoom_start(j1 - 1, zoomy);
+		r[1].height = y1 - r[1].y;
+		r[2].width = zoom_start(i0 + 1, zoomx) - x0;
+		r[3].x = zoom_start(i1 - 1, zoomx);
+		r[3].width = x1 - r[3].x;
+		r[2].y = r[3].y = r[0].y + r[0].height;
+		r[2].height = r[3].height = r[1].y - r[2].y;
+		XFillRectangles(dpy, win, invert_gc, r, 4);
+	}
+}
+#endif
+
+/* monotonic time in microseconds */
+long long
+now_usec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* CPU time used by all our threads in microseconds */
+long long
+cpu_usec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+#include "stats.h"
+
+/* time from the start of a frame to the start of the next one.
+   With AUTO_DELAY we go as fast as the frame rate target lets
+   us, but never faster than frames can be made and slow down
+   so that the CPU used stays under the CPU target. A bigger
+   window or magnification then automatically means less frames */
+long long
+frame_interval(void) {
+	double fps = target_fps, cpu = target_cpu;
+	long long t;
+
+	if(delay != AUTO_DELAY)
+		return delay > MIN_DELAY ? delay : MIN_DELAY;
+
+	if(fps <= 0 && cpu <= 0) {
+		fps = DEFAULT_FPS;
+		cpu = DEFAULT_CPU;
+	}
+
+	t = fps > 0 ? 1000000 / fps : 0;
+
+	if(t < frame_cost)
+		t = frame_cost;
+	if(cpu > 0 && t < frame_cpu / cpu)
+		t = frame_cpu / cpu;
+
+	return t > MIN_DELAY ? t : MIN_DELAY;
+}
+
+#ifdef XSHM
+#include "capture.h"
+#endif
+#include "record.h"
+#include "export.h"
+
+char *export_name = NULL;			/* -export */
+char export_path[256];				/* the name for shm_open() */
+struct export_header *export_map;
+size_t export_size;
+
+/* give the shared memory of -export its name back, readers
+   which have it mapped keep it */
+void
+finish_export(void) {
+	export_map->closed = True;
+	shm_unlink(export_path);
+}
+
+/* make the shared memory of -export, see export.h, with frames
+   big enough for a window of the size of the screen */
+void
+init_export(XImage *image) {
+	struct export_header *h;
+	size_t frame_size;
+	int fd;
+
+	snprintf(export_path, sizeof(export_path), "%s%s",
+		export_name[0] == '/' ? "" : "/", export_name);
+
+	frame_size = (size_t)WidthOfScreen(scr) * HeightOfScreen(scr) *
+		image->bits_per_pixel / 8;
+	frame_size = (frame_size + 4095) & ~(size_t)4095;
+	export_size = 4096 + NEXPORT * frame_size;
+
+	fd = shm_open(export_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(fd < 0) {
+		perror(export_path);
+		exit(-1);
+	}
+	if(ftruncate(fd, export_size) < 0) {
+		perror("ftruncate");
+		exit(-1);
+	}
+	export_map = mmap(NULL, export_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if(export_map == MAP_FAILED) {
+		perror("mmap");
+		exit(-1);
+	}
+	close(fd);
+
+	h = export_map;
+	h->version = EXPORT_VERSION;
+	h->size = sizeof(struct export_header);
+	h->nframes = NEXPORT;
+	h->frame_offset = 4096;
+	h->frame_size = frame_size;
+	h->bits_per_pixel = image->bits_per_pixel;
+	h->depth = image->depth;
+	h->red_mask = image->red_mask;
+	h->green_mask = image->green_mask;
+	h->blue_mask = image->blue_mask;
+	h->byte_order = image->byte_order == MSBFirst;
+	h->pid = getpid();
+	__atomic_store_n(&h->magic, EXPORT_MAGIC, __ATOMIC_RELEASE);
+
+	atexit(finish_export);
+}
+
+/* copy the picture in ximage[DST], with the cursor, into the frame
+   after the latest one and make that the latest */
+void
+export_frame(void) {
+	struct export_header *h = export_map;
+	struct export_frame *f;
+	int k = (h->latest + 1) % NEXPORT;
+	int n = width[DST] * ximage[DST]->bits_per_pixel / 8;
+	char *p;
+	int y;
+
+	if((size_t)n * height[DST] > h->frame_size)
+		return;					/* bigger than the screen */
+
+	f = &h->frames[k];
+	p = (char *)h + h->frame_offset + k * h->frame_size;
+
+	export_write_begin(f);
+	for(y = 0; y < height[DST]; y++)
+		memcpy(p + y * n, ximage[DST]->data +
+			y * ximage[DST]->bytes_per_line, n);
+	f->width = width[DST];
+	f->height = height[DST];
+	f->bytes_per_line = n;
+	f->number = h->number + 1;
+	f->time = now_usec();
+	f->src_x = src_x;
+	f->src_y = src_y;
+	f->src_width = width[SRC];
+	f->src_height = height[SRC];
+	f->zoomx = zoomx;
+	f->zoomy = zoomy;
+	f->flipx = flipx;
+	f->flipy = flipy;
+	f->flipxy = flipxy;
+	f->filter = filter;
+	export_write_end(f);
+
+	h->latest = k;
+	__atomic_store_n(&h->number, f->number, __ATOMIC_RELEASE);
+}
+
+/* sleep until there is input from the server or until the next frame
+   is due. Frames are due every delay while we poll the source area
+   (no XDamage) or when polling says so; with XDamage only when some
+   damage is waiting to be looked at. When nothing is going on we
+   sleep in poll() until the server sends something */
+void
+wait_for_frame(int polling) {
+	struct pollfd pfd[3];
+	struct itimerspec its;
+	struct view *v;
+	long long now, title_next;
+	int timeout, n = 2;
+	uint64_t expired;
+
+#ifdef XDAMAGE
+	polling = polling || damage_pending || damage == None;
+#else
+	polling = True;
+#endif
+
+	memset(&its, 0, sizeof(its));
+	save_view();
+
+	while(!frame_due && !XPending(dpy)) {
+		now = now_usec();
+
+		/* every view has its own title to restore */
+		title_next = 0;
+		for(v = views; v < views + nviews; v++) {
+			if(v->title_timeout && now >= v->title_timeout) {
+				use_view(v);
+				title_timeout = 0;
+				set_title = True;
+				return;
+			}
+			if(v->title_timeout &&
+			   (!title_next || v->title_timeout < title_next))
+				title_next = v->title_timeout;
+		}
+
+		if(polling && now >= next_frame) {
+			frame_due = True;
+			return;
+		}
+
+		if(stats_name && stats_interval > 0 && now >= stats_next)
+			return;
+
+		/* arm the timer for the next frame, or disarm it */
+		if(polling) {
+			its.it_value.tv_sec = next_frame / 1000000;
+			its.it_value.tv_nsec = next_frame % 1000000 * 1000;
+		}
+		timerfd_settime(frame_timer, TFD_TIMER_ABSTIME, &its, NULL);
+
+		timeout = -1;
+		if(title_next)
+			timeout = (title_next - now + 999) / 1000;
+		if(stats_name && stats_interval > 0 &&
+		   (timeout < 0 || (stats_next - now + 999) / 1000 < timeout))
+			timeout = (stats_next - now + 999) / 1000;
+
+		pfd[0].fd = ConnectionNumber(dpy);
+		pfd[0].events = POLLIN;
+		pfd[1].fd = frame_timer;
+		pfd[1].events = POLLIN;
+#ifdef XSHM
+		/* a new frame from the capture thread */
+		if(pipeline) {
+			pfd[2].fd = capture_fd;
+			pfd[2].events = POLLIN;
+			n = 3;
+		}
+#endif
+
+		if(poll(pfd, n, timeout) < 0)
+			return;		/* a signal, see stats_check() */
+
+#ifdef XSHM
+		if(pipeline && (pfd[2].revents & POLLIN))
+			return;
+#endif
+
+		if(pfd[1].revents & POLLIN) {
+			if(read(frame_timer, &expired, sizeof(expired)) > 0)
+				frame_due = True;
+		}
+	}
+}
+
+/* check if anything that affects the displayed image changed
+   since the last update, and remember the new state */
+int
+state_changed(void) {
+	int changed;
+
+	/* moving alone is done by scroll_window() */
+	changed = (flipxy && (shown.xgrab != xgrab || shown.ygrab != ygrab)) ||
+		shown.width[SRC] != width[SRC] || shown.height[SRC] != height[SRC] ||
+		shown.width[DST] != width[DST] || shown.height[DST] != height[DST] ||
+		shown.zoomx != zoomx || shown.zoomy != zoomy ||
+		shown.filter != filter ||
+		shown.flipxy != flipxy || shown.flipx != flipx || shown.flipy != flipy ||
+		shown.gridx != gridx || shown.gridy != gridy;
+
+	shown.xgrab = xgrab;
+	shown.ygrab = ygrab;
+	shown.width[SRC] = width[SRC];
+	shown.height[SRC] = height[SRC];
+	shown.width[DST] = width[DST];
+	shown.height[DST] = height[DST];
+	shown.zoomx = zoomx;
+	shown.zoomy = zoomy;
+	shown.filter = filter;
+	shown.flipxy = flipxy;
+	shown.flipx = flipx;
+	shown.flipy = flipy;
+	shown.gridx = gridx;
+	shown.gridy = gridy;
+
+	return changed;
+}
+
+/* check if the cursor has to be drawn again, and remember
+   where it is. Only its lines are updated then */
+int
+cursor_changed(int show_cursor, int cursor_x, int cursor_y) {
+	int changed;
+
+	changed = shown.show_cursor != show_cursor ||
+		(show_cursor &&
+		 (shown.cursor_x != cursor_x || shown.cursor_y != cursor_y));
+#ifdef XFIXES
+	if(show_cursor && cursor_stale)
+		changed = True;
+#endif
+
+	shown.show_cursor = show_cursor;
+	shown.cursor_x = cursor_x;
+	shown.cursor_y = cursor_y;
+
+	return changed;
+}
+
+void
+Usage(void) {
+	fprintf(stderr, "Usage: %s [ args ]\n"
+		"Command line args:\n"
+		"-display displayname\n"
+		"-mag magnification [ magnification ]\n"
+		"-filter nearest|bilinear\n"
+		"-geometry geometry\n"
+		"-source geometry\n"
+		"-x\n"
+		"-y\n"
+		"-xy\n"
+		"-follow\n"
+		"-no-follow\n"
+		"-cursor\n"
+		"-no-cursor\n"
+		"-threads n\n"
+		"-delay ms\n"
+		"-fps frames_per_second\n"
+		"-cpu fraction\n"
+		"-record file\n"
+		"-export name\n"
+		"-rows\n"
+		"-stats file\n"
+		"-stats-interval seconds\n"
+		"-view: the options after it are for a new window\n"
+#ifdef XDAMAGE
+		"-guard pixels\n"
+#endif
+#ifdef XSHM
+		"-pipeline\n"
+#endif
+#ifdef XRENDER
+		"-backend shm|xlib|render\n"
+		"-render\n"
+#else
+		"-backend shm|xlib\n"
+#endif
+		"\n"
+		"Window commands:\n"
+		"+: Zoom in\n"
+		"-: Zoom out\n"
+		"x: Flip right and left\n"
+		"y: Flip top and bottom\n"
+		"z: Rotate 90 degrees counter-clockwize\n"
+		"w: Next '+' or '-' only change width scaling\n"
+		"h: Next '+' or '-' only change height scaling\n"
+		"f: Turn ON or OFF follow mouse\n"
+		"c: Turn ON or OFF show cursor\n"
+		"b: Turn ON or OFF the bilinear filter\n"
+		"d: Change delay between frames\n"
+		"q: Quit\n"
+		"Arrow keys: Scroll in direction of arrow\n"
+		"Mouse button drag: Set top-left corner of viewed area\n",
+		progname);
+	exit(1);
+}
+
+#include "replicate.h"
+
+/* scaling kernels, see kernels.h */
+#define NFIXED		4				/* magx values with their own kernels */
+#define NORIENT		3				/* orientations with their own kernels */
+
+#define ORIENT_NONE	0
+#define ORIENT_X	1
+#define ORIENT_XY	2
+
+int fixed_mags[NFIXED] = { 2, 3, 4, 8 };
+
+#define T unsigned char
+#define REP rep8
+#define SCALE scale8
+#define SCALE_TABLE scale8_table
+#include "kernels.h"
+void draw_cursor8(int cx, int cy)
+#include "cursor.h"
+#undef SCALE_TABLE
+#undef SCALE
+#undef REP
+#undef T
+
+#define T unsigned short
+#define REP rep16
+#define SCALE scale16
+#define SCALE_TABLE scale16_table
+#define MIX blend16
+#define SWAP __builtin_bswap16
+#include "kernels.h"
+void draw_cursor16(int cx, int cy)
+#include "cursor.h"
+/* the rest copies pixels as they are, only the filter mixes them */
+#define BLEND blend16_swapped
+void scale16_bilinear_swapped(int j0, int j1, int i0, int i1)
+#include "fscale.h"
+#undef BLEND
+#undef SWAP
+#undef MIX
+#undef SCALE_TABLE
+#undef SCALE
+#undef REP
+#undef T
+
+#define T unsigned int
+#define REP rep32
+#define SCALE scale32
+#define SCALE_TABLE scale32_table
+#define MIX blend32
+#define MIX_LINE blend_line32
+#define SWAP __builtin_bswap32
+#include "kernels.h"
+void draw_cursor32(int cx, int cy)
+#include "cursor.h"
+#undef SWAP
+#undef MIX_LINE
+#undef MIX
+#undef SCALE_TABLE
+#undef SCALE
+#undef REP
+#undef T
+
+#include "pixel24.h"
+
+/* LSBFirst or MSBFirst, as this machine keeps its words */
+int
+host_byte_order(void) {
+	unsigned int one = 1;
+
+	return *(unsigned char *)&one ? LSBFirst : MSBFirst;
+}
+
+/* the bilinear filter needs TrueColor pixels of 16 or 32 bits,
+   with channels blend16() or blend32() can mix */
+int
+can_blend(void) {
+	Visual *visual = DefaultVisualOfScreen(scr);
+	int bpp = ximage[SRC]->bits_per_pixel;
+
+	if(visual->class != TrueColor && visual->class != DirectColor)
+		return False;
+
+	if(bpp == 32)
+		return ((visual->red_mask | visual->green_mask | visual->blue_mask) &
+			~0xffffffUL) == 0 &&
+			(visual->red_mask == 0xff || visual->red_mask == 0xff0000) &&
+			visual->green_mask == 0xff00;
+
+	if(bpp == 16 && visual->green_mask == 0x7e0) {
+		blend16_mask = 0x07e0f81f;
+		return True;
+	}
+	if(bpp == 16 && visual->green_mask == 0x3e0) {
+		blend16_mask = 0x03e07c1f;
+		return True;
+	}
+
+	return False;
+}
+
+/* pick the kernel for the pixels of the images, zoom, filter and
+   orientation and make the tables of zoom.h. Called whenever one of
+   them changes. The pixels are what the images have, bits_per_pixel
+   and byte_order, not what the depth of the screen suggests */
+void
+select_kernel(void) {
+	int bpp = ximage[SRC]->bits_per_pixel;
+	int m, o, whole;
+
+	if(bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32) {
+		fprintf(stderr, "%s: no kernel for %d bits/pixel\n",
+			progname, bpp);
+		exit(1);
+	}
+	swap_pixels = bpp > 8 && ximage[SRC]->byte_order != host_byte_order();
+
+	if(filter == FILTER_BILINEAR && !can_blend()) {
+		fprintf(stderr, "%s: no bilinear filter for this visual\n",
+			progname);
+		filter = FILTER_NEAREST;
+	}
+
+	zoom_tables();
+	whole = zoomx == magx && zoomy == magy;
+
+	for(m = 0; m < NFIXED && fixed_mags[m] != magx; m++)
+		;
+
+	if(flipxy)
+		o = ORIENT_XY;
+	else if(flipx)
+		o = ORIENT_X;
+	else
+		o = ORIENT_NONE;
+
+	if (bpp == 8) {
+		scale_kernel = !whole ? scale8_frac :
+			m < NFIXED ? scale8_table[m][o] : scale8;
+		cursor_kernel = draw_cursor8;
+	}
+	else if (bpp == 16) {
+		scale_kernel = filter == FILTER_BILINEAR ?
+			(swap_pixels ? scale16_bilinear_swapped : scale16_bilinear) :
+			!whole ? scale16_frac :
+			m < NFIXED ? scale16_table[m][o] : scale16;
+		cursor_kernel = draw_cursor16;
+	}
+	else if (bpp == 24) {
+		scale_kernel = scale24;
+		cursor_kernel = draw_cursor24;
+	}
+	else {
+		scale_kernel = filter == FILTER_BILINEAR ? scale32_bilinear :
+			!whole ? scale32_frac :
+			m < NFIXED ? scale32_table[m][o] : scale32;
+		cursor_kernel = draw_cursor32;
+	}
+}
+
+/* resize is called with the dest size.
+   we call it then manification changes or when
+   actual window size is changed */
+void
+resize(int new_width, int new_height) {
+
+	destroy_images();		/* we can get rid of these */
+
+	/* find new dimensions for source */
+
+	magx = zoomx;
+	magy = zoomy;
+
+	if(flipxy) {
+		height[SRC] = ceil(new_width / zoomx);
+		width[SRC] = ceil(new_height / zoomy);
+	}
+	else {
+		width[SRC] = ceil(new_width / zoomx);
+		height[SRC] = ceil(new_height / zoomy);
+	}
+
+	if(width[SRC] < 1)
+		width[SRC] = 1;
+	if(width[SRC] > WidthOfScreen(scr))
+		width[SRC] = WidthOfScreen(scr);
+
+	if(height[SRC] < 1)
+		height[SRC] = 1;
+	if(height[SRC] > HeightOfScreen(scr))
+		height[SRC] = HeightOfScreen(scr);
+
+	/* temporary, the dest image may be larger than the
+	   actual window */
+	if(flipxy) {
+		width[DST] = zoom_start(height[SRC], zoomx);
+		height[DST] = zoom_start(width[SRC], zoomy);
+	}
+	else {
+		width[DST] = zoom_start(width[SRC], zoomx);
+		height[DST] = zoom_start(height[SRC], zoomy);
+	}
+
+	allocate_images();		/* allocate new images */
+	select_kernel();
+	force_update = True;
+
+	/* remember actual window size */
+	if(width[DST] > new_width)
+		width[DST] = new_width;
+	if(height[DST] > new_height)
+		height[DST] = new_height;
+}
+
+
+/* scale band n of nthreads of every span */
+void
+scale_band(int n) {
+	int i, j0, j1;
+
+	for(i = 0; i < nspans; i++) {
+		j0 = spans[i].j0;
+		j1 = spans[i].j1;
+		scale_kernel(j0 + (j1 - j0) * n / nthreads,
+			j0 + (j1 - j0) * (n + 1) / nthreads,
+			spans[i].i0, spans[i].i1);
+	}
+}
+
+void *
+scale_worker(void *arg) {
+	int n = (long)arg;
+	int frame = 0;
+
+	blend_thread = n;
+	pthread_mutex_lock(&pool_lock);
+	for(;;) {
+		while(pool_frame == frame)
+			pthread_cond_wait(&pool_start, &pool_lock);
+		frame = pool_frame;
+		pthread_mutex_unlock(&pool_lock);
+
+		scale_band(n);
+
+		pthread_mutex_lock(&pool_lock);
+		if(--pool_busy == 0)
+			pthread_cond_signal(&pool_done);
+	}
+	return NULL;
+}
+
+/* start the worker threads, they wait for jobs from scale_spans() */
+void
+init_workers(void) {
+	pthread_t thread;
+	long n;
+
+	if(nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthreads < 1)
+		nthreads = 1;
+	if(nthreads > MAXTHREADS)
+		nthreads = MAXTHREADS;
+	blend_threads = nthreads;
+
+	for(n = 1; n < nthreads; n++) {
+		if(pthread_create(&thread, NULL, scale_worker, (void *)n)) {
+			perror("pthread_create");
+			exit(-1);
+		}
+		pthread_detach(thread);
+	}
+}
+
+/* scale all the spans, main() does band 0 and waits
+   for the workers to finish the others */
+void
+scale_spans(void) {
+	int i, pixels = 0;
+
+	for(i = 0; i < nspans; i++)
+		pixels += (block_y[spans[i].j1] - block_y[spans[i].j0]) *
+			(block_x[spans[i].i1] - block_x[spans[i].i0]);
+
+	if(nthreads <= 1 || pixels < THREAD_PIXELS) {
+		for(i = 0; i < nspans; i++)
+			scale_kernel(spans[i].j0, spans[i].j1,
+				spans[i].i0, spans[i].i1);
+		return;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	pool_busy = nthreads - 1;
+	pool_frame++;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_lock);
+
+	scale_band(0);
+
+	pthread_mutex_lock(&pool_lock);
+	while(pool_busy > 0)
+		pthread_cond_wait(&pool_done, &pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+/* put columns x0 .. x1-1 of image lines y0 .. y1-1 of DST into d,
+   at the same columns from line y on. Without shared memory the
+   lines go in requests as big as the server takes, with BIG-REQUESTS
+   if it has them, instead of letting Xlib split them */
+void
+put_image(Drawable d, int x0, int x1, int y0, int y1, int y) {
+	long max;
+	int n;
+
+#ifdef XSHM
+	if(use_shm) {
+		XShmPutImage(dpy, d, gc, ximage[DST], x0, y0, x0, y,
+			x1 - x0, y1 - y0, True);
+		buffer_puts[buffer]++;
+		return;
+	}
+#endif
+
+	max = XExtendedMaxRequestSize(dpy);
+	if(max == 0)
+		max = XMaxRequestSize(dpy);
+	n = (max * 4 - PUT_HEADER) /
+		(((x1 - x0) * ximage[DST]->bits_per_pixel + 31) / 32 * 4);
+	if(n < 1)
+		n = 1;
+
+	for(; y0 < y1; y0 += n, y += n)
+		XPutImage(dpy, d, gc, ximage[DST], x0, y0, x0, y, x1 - x0,
+			y1 - y0 < n ? y1 - y0 : n);
+}
+
+/* the columns of DST of blocks i0 .. i1-1, in the window */
+void
+span_columns(int i0, int i1, int *x0, int *x1) {
+	*x0 = block_x[i0];
+	*x1 = block_x[i1] < width[DST] ? block_x[i1] : width[DST];
+}
+
+/* put lines j0 .. j1-1 and columns i0 .. i1-1 of DST into the window */
+void
+put_lines(int j0, int j1, int i0, int i1) {
+	int y0 = block_y[j0];
+	int y1 = block_y[j1];
+	int x0, x1;
+
+	span_columns(i0, i1, &x0, &x1);
+	if(y1 > height[DST])
+		y1 = height[DST];
+	if(y0 >= y1 || x0 >= x1)
+		return;
+
+	put_image(win, x0, x1, y0, y1, y0);
+}
+
+#include "rows.h"
+
+#ifdef XDAMAGE
+#include "band.h"
+#endif
+
+/* grab the source areas of the views to update, see views.h.
+   Two areas are grabbed as one when they overlap or when the
+   rectangle around them is no bigger than the two, so views far
+   apart do not grab what lies between them. A view with a grab of
+   its own grabs into its SRC image as it always did */
+void
+grab_views(void) {
+	struct view *v;
+	struct grab *g, *h;
+	int in[MAXVIEWS];				/* the grab of each view */
+	int ngrabs = 0, merged, n, k, a, b, x0, y0, x1, y1;
+	long long t = 0;
+
+	save_view();
+
+#ifdef XDAMAGE
+	if(guard) {
+		STAT_START(t);
+		for(v = views; v < views + nviews; v++)
+			if(v->update)
+				band_source(v);
+		STAT_STOP(ST_GRAB, t);
+		view_vars(False);
+		return;
+	}
+#endif
+
+	for(k = 0; k < nviews; k++) {
+		v = &views[k];
+		in[k] = -1;
+		if(!v->update)
+			continue;
+		g = &grabs[ngrabs];
+		g->x0 = v->xgrab;
+		g->y0 = v->ygrab;
+		g->x1 = v->xgrab + v->width[SRC];
+		g->y1 = v->ygrab + v->height[SRC];
+		in[k] = ngrabs++;
+	}
+
+	do {
+		merged = False;
+		for(a = 0; a < ngrabs; a++)
+			for(b = a + 1; b < ngrabs; b++) {
+				g = &grabs[a];
+				h = &grabs[b];
+				x0 = g->x0 < h->x0 ? g->x0 : h->x0;
+				y0 = g->y0 < h->y0 ? g->y0 : h->y0;
+				x1 = g->x1 > h->x1 ? g->x1 : h->x1;
+				y1 = g->y1 > h->y1 ? g->y1 : h->y1;
+				if((g->x1 <= h->x0 || h->x1 <= g->x0 ||
+				    g->y1 <= h->y0 || h->y1 <= g->y0) &&
+				   (long)(x1 - x0) * (y1 - y0) >
+				   (long)(g->x1 - g->x0) * (g->y1 - g->y0) +
+				   (long)(h->x1 - h->x0) * (h->y1 - h->y0))
+					continue;
+
+				/* b goes into a, the last one takes its place */
+				g->x0 = x0;
+				g->y0 = y0;
+				g->x1 = x1;
+				g->y1 = y1;
+				ngrabs--;
+				h->x0 = grabs[ngrabs].x0;
+				h->y0 = grabs[ngrabs].y0;
+				h->x1 = grabs[ngrabs].x1;
+				h->y1 = grabs[ngrabs].y1;
+				for(k = 0; k < nviews; k++)
+					if(in[k] == b)
+						in[k] = a;
+					else if(in[k] == ngrabs)
+						in[k] = b;
+				merged = True;
+			}
+	} while(merged);
+
+	STAT_START(t);
+	for(a = 0; a < ngrabs; a++) {
+		g = &grabs[a];
+		for(n = k = 0; k < nviews; k++)
+			if(in[k] == a) {
+				v = &views[k];
+				n++;
+			}
+
+		if(n == 1) {
+			v->ximage[SRC] = v->images[0];
+			x0 = g->x0;
+			y0 = g->y0;
+		}
+		else {
+			x1 = g->x1 - g->x0;
+			y1 = g->y1 - g->y0;
+			if(!g->image ||
+			   g->image->width != x1 || g->image->height != y1) {
+				if(g->image) {
+#ifdef XSHM
+					if(!use_shm)
+#endif
+					free(g->image->data);
+					g->image->data = NULL;
+					XDestroyImage(g->image);
+				}
+#ifdef XSHM
+				if(use_shm)
+					g->image = shm_image(dpy, &g->shminfo, &g->size, x1, y1);
+				else
+#endif
+				g->image = plain_image(x1, y1);
+			}
+			x0 = g->x0;
+			y0 = g->y0;
+		}
+
+		/* v is the view when there is one */
+#ifdef XSHM
+		if(use_shm)
+			XShmGetImage(dpy, RootWindowOfScreen(scr),
+				n == 1 ? v->ximage[SRC] : g->image, x0, y0, AllPlanes);
+		else
+#endif
+		XGetSubImage(dpy, RootWindowOfScreen(scr),
+			x0, y0, g->x1 - x0, g->y1 - y0, AllPlanes,
+			ZPixmap, n == 1 ? v->ximage[SRC] : g->image, 0, 0);
+
+		for(k = 0; k < nviews; k++) {
+			if(in[k] != a)
+				continue;
+			v = &views[k];
+			v->src_x = v->xgrab;
+			v->src_y = v->ygrab;
+			if(n == 1)
+				continue;
+
+			/* its part of the grab */
+			v->part = *g->image;
+			v->part.width = v->width[SRC];
+			v->part.height = v->height[SRC];
+			v->part.data += (v->ygrab - y0) * g->image->bytes_per_line +
+				(v->xgrab - x0) * g->image->bits_per_pixel / 8;
+			v->ximage[SRC] = &v->part;
+		}
+	}
+	STAT_STOP(ST_GRAB, t);
+
+	view_vars(False);
+}
+
+/* make the window of the view in the globals, as the
+   command line asked for it */
+void
+open_view(void) {
+	XSetWindowAttributes xswa;
+	int copy_from_src_mask = NoValue;
+
+	/* see if we have to calculate width[DST] and height[DST]
+	   from the SRC parameters */
+	if(view->source_geom_mask & WidthValue) {
+		if(flipxy) {
+			height[DST] = zoom_start(width[SRC], zoomy);
+			copy_from_src_mask |= HeightValue;
+
+		}
+		else {
+			width[DST] = zoom_start(width[SRC], zoomx);
+			copy_from_src_mask |= WidthValue;
+		}
+	}
+
+	if(view->source_geom_mask & HeightValue) {
+		if(flipxy) {
+			width[DST] = zoom_start(height[SRC], zoomx);
+			copy_from_src_mask |= WidthValue;
+		}
+		else {
+			height[DST] = zoom_start(height[SRC], zoomy);
+			copy_from_src_mask |= HeightValue;
+		}
+	}
+
+	if(copy_from_src_mask & view->dest_geom_mask) {
+		fprintf(stderr, "Conflicting dimensions between source and dest geometry\n");
+		Usage();
+	}
+
+	if(view->source_geom_mask & XNegative)
+		xgrab += WidthOfScreen(scr);
+
+	if(view->source_geom_mask & YNegative)
+		ygrab += HeightOfScreen(scr);
+
+	if(view->dest_geom_mask & XNegative)
+		view->xpos += WidthOfScreen(scr);
+
+	if(view->source_geom_mask & YNegative)
+		view->ypos += HeightOfScreen(scr);
+
+	/* printf("=%dx%d+%d+%d\n", width[DST], height[DST], view->xpos, view->ypos); */
+
+	xswa.event_mask = ButtonPressMask|ButtonReleaseMask|ButtonMotionMask;
+	xswa.event_mask |= StructureNotifyMask;	/* resize etc.. */
+	xswa.event_mask |= KeyPressMask|KeyReleaseMask;		/* commands */
+	xswa.event_mask |= ExposureMask;	/* redraw when nothing changes */
+	xswa.background_pixel = BlackPixelOfScreen(scr);
+
+	win = XCreateWindow(dpy, RootWindowOfScreen(scr),
+	    view->xpos, view->ypos, width[DST], height[DST], 0,
+	    DefaultDepthOfScreen(scr), InputOutput,
+	    DefaultVisualOfScreen(scr),
+	    CWEventMask | CWBackPixel, &xswa);
+
+	XChangeProperty(dpy, win, XA_WM_ICON_NAME, XA_STRING, 8,
+			PropModeReplace,
+			(unsigned char *)progname, strlen(progname));
+
+	/*
+	XChangeProperty(dpy, win, XA_WM_NAME, XA_STRING, 8,
+			PropModeReplace,
+			(unsigned char *)progname, strlen(progname));
+	*/
+
+
+ 	/***	20020213
+		code added by <tmancill@debian.org> to handle
+		window manager "close" event
+	***/
+	wm_delete_window = XInternAtom (dpy, "WM_DELETE_WINDOW", False);
+	wm_protocols = XInternAtom(dpy, "WM_PROTOCOLS", False);
+        status = XSetWMProtocols(dpy, win, &wm_delete_window, 1);
+
+	set_title = True;
+
+	status = XMapWindow(dpy, win);
+
+	resize(width[DST], height[DST]);
+	XDefineCursor(dpy, win, crosshair);
+#ifdef XRENDER
+	if(use_render)
+		init_render();
+#endif
+}
+
+Bool
+is_window_event(Display *display, XEvent *event, XPointer arg) {
+	return event->type != GenericEvent &&
+		event->xany.window == *(Window *)arg;
+}
+
+/* the window of the view in the globals was closed: its window,
+   images, segments and pixmaps go and the views after it move
+   down. The first view is in the globals after that, if any */
+void
+close_view(void) {
+	XEvent event;
+	int i;
+#ifdef XDAMAGE
+	XImage *image;
+	int k;
+#endif
+
+	/* the server is done with the segments after this, and the
+	   events still coming for the window are thrown away */
+	XSync(dpy, False);
+#ifdef XSHM
+	while(XCheckIfEvent(dpy, &event, is_shm_completion, NULL))
+		shm_completed(&event);
+#endif
+
+	destroy_images();
+#ifdef XSHM
+	for(i = 0; i < NIMAGES; i++)
+		if(shm_size[i] > 0) {
+			XShmDetach(dpy, &shminfo[i]);
+			shmdt(shminfo[i].shmaddr);
+		}
+#endif
+#ifdef XDAMAGE
+	for(k = 0; k < 2; k++) {
+		image = view->band.image[k];
+		if(!image)
+			continue;
+#ifdef XSHM
+		if(use_shm) {
+			XShmDetach(dpy, &view->band.shminfo[k]);
+			shmdt(view->band.shminfo[k].shmaddr);
+		}
+		else
+#endif
+		free(image->data);
+		image->data = NULL;
+		XDestroyImage(image);
+	}
+#endif
+#ifdef XRENDER
+	if(render_pixmap != None) {
+		XRenderFreePicture(dpy, render_src);
+		XFreePixmap(dpy, render_pixmap);
+	}
+	if(render_dst != None)
+		XRenderFreePicture(dpy, render_dst);
+#endif
+	if(rows_pixmap != None)
+		XFreePixmap(dpy, rows_pixmap);
+	XDestroyWindow(dpy, win);
+	XSync(dpy, False);
+	while(XCheckIfEvent(dpy, &event, is_window_event, (XPointer)&win))
+		;
+
+	for(i = 0; i < nbuffers; i++) {
+		free(stale[i]);
+		free(stale_columns[i]);
+	}
+	free(prev_src);
+	free(block_x);
+	free(block_y);
+	free(col_off0);
+	free(col_off1);
+	free(col_w);
+	free(line_off0);
+	free(line_off1);
+	free(line_w);
+	free(blend_rows);
+
+	nviews--;
+	memmove(view, view + 1, (views + nviews - view) * sizeof(*view));
+	view = views;
+	if(nviews > 0)
+		view_vars(False);
+}
+
+/* draw the view in the globals into its window: let the server do
+   it with the render backend, otherwise scale what changed in the
+   grab, draw the cursor over it and put it */
+void
+draw_view(int root_x, int root_y) {
+	int ci0, ci1, cj0, cj1;				/* DST blocks under the cursor */
+	long long t = 0;
+	int i, rows;
+
+	damaged = False;
+	cursor_dirty = False;
+
+#ifdef XRENDER
+	if(use_render) {
+		force_update = False;
+		src_x = xgrab;
+		src_y = ygrab;
+		STAT_START(t);
+		render_frame(show_cursor, root_x, root_y);
+		STAT_STOP(ST_PUT, t);
+#ifdef FRAME
+		if(buttonpressed) {	/* show the frame */
+			DRAW_FRAME();
+			XSync(dpy, False);
+		}
+#endif
+		return;
+	}
+#endif
+
+#ifdef FRAME
+	if(buttonpressed) {	/* show the frame */
+		DRAW_FRAME();
+		XSync(dpy, False);
+	}
+#endif
+
+#ifdef XFIXES
+	if (show_cursor)
+		load_cursor();
+#endif
+
+	/* SRC may be part of a wider grab than the last time,
+	   see grab_views() */
+	if(ximage[SRC]->bytes_per_line != tables_bpl)
+		zoom_tables();
+
+	STAT_START(t);
+	find_dirty_lines();
+	force_update = False;
+
+	/* the lines under the old cursor have to be restored */
+	if (cursor_j1 > cursor_j0) {
+		add_span(cursor_j0, cursor_j1);
+		cursor_j0 = cursor_j1 = 0;
+	}
+
+	if (show_cursor) {
+		/* the cursor is drawn over what was scaled, scale
+		   its lines again so that it does not invert itself */
+		cursor_blocks(root_x, root_y, &ci0, &ci1, &cj0, &cj1);
+		add_span(cj0, cj1);
+	}
+
+	/* the window needs the lines in the spans, the DST image
+	   we scale into also those which changed since it was
+	   last used */
+	mark_stale();
+	memcpy(put_spans, spans, nspans * sizeof(struct span));
+	nput_spans = nspans;
+	next_buffer();
+	shift_buffer();
+	stale_spans();
+
+	rows = use_rows();
+	if (rows)
+		rows_tables(True);
+	scale_spans();
+	STAT_STOP(ST_SCALE, t);
+
+	STAT_START(t);
+	if (show_cursor) {
+		cursor_kernel(root_x - cursor_xhot - src_x,
+			root_y - cursor_yhot - src_y);
+		cursor_j0 = cj0;
+		cursor_j1 = cj1;
+	}
+	if (rows)
+		rows_tables(False);
+	STAT_STOP(ST_CURSOR, t);
+
+	STAT_START(t);
+	for (i = 0; i < nput_spans; i++)
+		if (rows)
+			put_rows(put_spans[i].j0, put_spans[i].j1,
+				put_spans[i].i0, put_spans[i].i1);
+		else
+			put_lines(put_spans[i].j0, put_spans[i].j1,
+				put_spans[i].i0, put_spans[i].i1);
+	STAT_STOP(ST_PUT, t);
+
+}
+
+int
+main(int argc, char **argv) {
+	int polling, pressed, following;
+	int updates;
+	int root_x = 0, root_y = 0;			/* where the pointer is */
+	int moved;							/* only moved, see scroll_window() */
+	struct view *v;
+#ifdef XSHM
+	int new_frame = False;				/* take_frame() got one */
+#endif
+#ifdef XDAMAGE
+	int fetched;						/* fetch_damage() was called */
+#endif
+
+	XEvent event;
+
+	long long frame_start = 0, frame_start_cpu = 0;
+	long long t = 0, frame_t = 0;			/* for STAT_START() */
+	int scroll = 1;
+	char title[80];
+	XGCValues gcv;
+	char *dpyname = NULL;
+	int source_geom_mask = NoValue,
+		dest_geom_mask = NoValue;
+	int xpos = 0, ypos = 0;
+
+	atexit(destroy_images);
+	zoomx = MAGX;
+	zoomy = MAGY;
+	progname = strrchr(argv[0], '/');
+	if(progname)
+		++progname;
+	else
+		progname = argv[0];
+
+	/* parse command line options */
 	while(--argc > 0) {
 		++argv;
 
-		if(!strcmp(argv[0], "-follow")) {
-			follow_mouse = True;
-			continue;
-		}
+		if(!strcmp(argv[0], "-follow")) {
+			follow_mouse = True;
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-no-follow")) {
+			follow_mouse = False;
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-cursor")) {
+			show_cursor = True;
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-no-cursor")) {
+			show_cursor = False;
+			continue;
+		}
+
+		if(argv[0][0] == '=') {
+			dest_geom_mask = XParseGeometry(argv[0],
+				&xpos, &ypos,
+				&width[DST], &height[DST]);
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-mag")) {
+			++argv; --argc;
+
+			zoomx = argc > 0 ? atof(argv[0]) : -1;
+
+			if(zoomx < 1)
+				Usage();
+
+
+			zoomy = argc > 1 ? atof(argv[1]) : -1;
+
+			if(zoomy <= 0)
+				zoomy = zoomx;
+			else if(zoomy < 1)
+				Usage();
+			else {
+				++argv; --argc;
+			}
+
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-x")) {
+			flipx = True;
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-y")) {
+			flipy = True;
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-z") ||
+		   !strcmp(argv[0], "-xy")) {
+			flipxy = True;
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-source")) {
+			++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			source_geom_mask = XParseGeometry(argv[0],
+				&xgrab, &ygrab,
+				&width[SRC], &height[SRC]);
+
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-dest") ||
+		   !strcmp(argv[0], "-geometry")) {
+			++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			dest_geom_mask = XParseGeometry(argv[0],
+				&xpos, &ypos,
+				&width[DST], &height[DST]);
+
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-view")) {
+			/* a new window, with the options so far */
+			if(nviews == MAXVIEWS)
+				Usage();
+			view->source_geom_mask = source_geom_mask;
+			view->dest_geom_mask = dest_geom_mask;
+			view->xpos = xpos;
+			view->ypos = ypos;
+			save_view();
+			views[nviews] = *view;
+			view = &views[nviews++];
+			continue;
+		}
+
+		if(!strcmp(argv[0], "-d") ||
+		   !strcmp(argv[0], "-display")) {
+
+		   	++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+		   	dpyname = argv[0];
+			continue;
+		}
+
+#ifdef XDAMAGE
+		if(!strcmp(argv[0], "-guard")) {
+			++argv; --argc;
+
+			guard = argc > 0 ? atoi(argv[0]) : -1;
+
+			if(guard < 0)
+				Usage();
+
+			continue;
+		}
+#endif
+
+		if(!strcmp(argv[0], "-rows")) {
+			server_rows = True;
+			continue;
+		}
+
+#ifdef XSHM
+		if(!strcmp(argv[0], "-pipeline")) {
+			pipeline = True;
+			continue;
+		}
+#endif
+
+		if(!strcmp(argv[0], "-filter")) {
+
+		   	++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			if(!strcmp(argv[0], "nearest"))
+				filter = FILTER_NEAREST;
+			else if(!strcmp(argv[0], "bilinear"))
+				filter = FILTER_BILINEAR;
+			else
+				Usage();
 
-		if(!strcmp(argv[0], "-no-follow")) {
-			follow_mouse = False;
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-cursor")) {
-			show_cursor = True;
+		if(!strcmp(argv[0], "-backend")) {
+
+		   	++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			if(!strcmp(argv[0], "shm"))
+				backend = BACKEND_SHM;
+			else if(!strcmp(argv[0], "xlib"))
+				backend = BACKEND_XLIB;
+#ifdef XRENDER
+			else if(!strcmp(argv[0], "render"))
+				backend = BACKEND_RENDER;
+#endif
+			else
+				Usage();
+
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-no-cursor")) {
-			show_cursor = False;
+#ifdef XRENDER
+		if(!strcmp(argv[0], "-render")) {
+			backend = BACKEND_RENDER;
 			continue;
 		}
+#endif
+
+		if(!strcmp(argv[0], "-threads")) {
+
+		   	++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			if(sscanf(argv[0], "%d", &nthreads) != 1 || nthreads < 1)
+				Usage();
 
-		if(argv[0][0] == '=') {
-			dest_geom_mask = XParseGeometry(argv[0],
-				&xpos, &ypos,
-				&width[DST], &height[DST]);
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-mag")) {
-			++argv; --argc;
+		if(!strcmp(argv[0], "-fps")) {
 
-			magx = argc > 0 ? atoi(argv[0]) : -1;
+		   	++argv; --argc;
 
-			if(magx <= 0)
+			if(argc < 1)
 				Usage();
 
+			if(sscanf(argv[0], "%lf", &target_fps) != 1 || target_fps <= 0)
+				Usage();
 
-			magy = argc > 1 ? atoi(argv[1]) : -1;
-
-			if(magy <= 0)
-				magy = magx;
-			else {
-				++argv; --argc;
-			}
+			delay_index = NDELAYS - 1;
+			delay = AUTO_DELAY;
 
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-x")) {
-			flipx = True;
-			continue;
-		}
+		if(!strcmp(argv[0], "-cpu")) {
+
+		   	++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			if(sscanf(argv[0], "%lf", &target_cpu) != 1 ||
+			   target_cpu <= 0 || target_cpu > 1)
+				Usage();
+
+			delay_index = NDELAYS - 1;
+			delay = AUTO_DELAY;
 
-		if(!strcmp(argv[0], "-y")) {
-			flipy = True;
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-z") ||
-		   !strcmp(argv[0], "-xy")) {
-			flipxy = True;
+		if(!strcmp(argv[0], "-record")) {
+
+		   	++argv; --argc;
+
+			if(argc < 1)
+				Usage();
+
+			record_name = argv[0];
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-source")) {
-			++argv; --argc;
+		if(!strcmp(argv[0], "-export")) {
+
+		   	++argv; --argc;
 
 			if(argc < 1)
 				Usage();
 
-			source_geom_mask = XParseGeometry(argv[0],
-				&xgrab, &ygrab,
-				&width[SRC], &height[SRC]);
-
+			export_name = argv[0];
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-dest") ||
-		   !strcmp(argv[0], "-geometry")) {
-			++argv; --argc;
+		if(!strcmp(argv[0], "-stats")) {
+
+		   	++argv; --argc;
 
 			if(argc < 1)
 				Usage();
 
-			dest_geom_mask = XParseGeometry(argv[0],
-				&xpos, &ypos,
-				&width[DST], &height[DST]);
-
+			stats_name = argv[0];
 			continue;
 		}
 
-		if(!strcmp(argv[0], "-d") ||
-		   !strcmp(argv[0], "-display")) {
+		if(!strcmp(argv[0], "-stats-interval")) {
 
 		   	++argv; --argc;
 
 			if(argc < 1)
 				Usage();
 
-		   	dpyname = argv[0];
+			if(sscanf(argv[0], "%d", &stats_interval) != 1 ||
+			   stats_interval < 0)
+				Usage();
+
 			continue;
 		}
 
@@ -517,45 +2997,51 @@ main(int argc, char **argv) {
 		Usage();
 	}
 
+	view->source_geom_mask = source_geom_mask;
+	view->dest_geom_mask = dest_geom_mask;
+	view->xpos = xpos;
+	view->ypos = ypos;
+	save_view();
+
+#ifdef XRENDER
+	use_render = backend == BACKEND_RENDER;
+#endif
+
+#ifdef XSHM
+#ifdef XRENDER
+	if(use_render)
+		pipeline = False;	/* the server grabs and scales */
+#endif
+	/* the capture thread has its own connection, but
+	   Xlib still has some state shared by all of them */
+	if(pipeline && !XInitThreads()) {
+		fprintf(stderr, "%s: no thread support in Xlib\n", progname);
+		exit(1);
+	}
+#endif
+
 	if (!(dpy = XOpenDisplay(dpyname))) {
 		perror("Cannot open display");
 		exit(-1);
 	}
 
-	/* Now, see if we have to calculate width[DST] and height[DST]
-	   from the SRC parameters */
-
-	copy_from_src_mask = NoValue;
-
-	if(source_geom_mask & WidthValue) {
-		if(flipxy) {
-			height[DST] = magy * width[SRC];
-			copy_from_src_mask |= HeightValue;
-
-		}
-		else {
-			width[DST] = magx * width[SRC];
-			copy_from_src_mask |= WidthValue;
-		}
-	}
+	scr = DefaultScreenOfDisplay(dpy);
 
-	if(source_geom_mask & HeightValue) {
-		if(flipxy) {
-			width[DST] = magx * height[SRC];
-			copy_from_src_mask |= WidthValue;
-		}
-		else {
-			height[DST] = magy * height[SRC];
-			copy_from_src_mask |= HeightValue;
-		}
+	init_backend();
+#ifdef XSHM
+	if(pipeline && !use_shm) {
+		fprintf(stderr, "%s: -pipeline needs shared memory\n", progname);
+		pipeline = False;
 	}
-
-	if(copy_from_src_mask & dest_geom_mask) {
-		fprintf(stderr, "Conflicting dimensions between source and dest geometry\n");
-		Usage();
+	if(pipeline && nviews > 1) {
+		fprintf(stderr, "%s: -pipeline only works with one view\n",
+			progname);
+		pipeline = False;
 	}
-
-	scr = DefaultScreenOfDisplay(dpy);
+#endif
+	init_replicate();
+	init_workers();
+	init_stats();
 
 	depth = DefaultDepthOfScreen(scr);
 	if (depth < 8) {
@@ -563,54 +3049,6 @@ main(int argc, char **argv) {
 		exit(1);
 	}
 
-	if(source_geom_mask & XNegative)
-		xgrab += WidthOfScreen(scr);
-
-	if(source_geom_mask & YNegative)
-		ygrab += HeightOfScreen(scr);
-
-	if(dest_geom_mask & XNegative)
-		xpos += WidthOfScreen(scr);
-
-	if(source_geom_mask & YNegative)
-		ypos += HeightOfScreen(scr);
-
-	/* printf("=%dx%d+%d+%d\n", width[DST], height[DST], xpos, ypos); */
-
-	xswa.event_mask = ButtonPressMask|ButtonReleaseMask|ButtonMotionMask;
-	xswa.event_mask |= StructureNotifyMask;	/* resize etc.. */
-	xswa.event_mask |= KeyPressMask|KeyReleaseMask;		/* commands */
-	xswa.background_pixel = BlackPixelOfScreen(scr);
-
-	win = XCreateWindow(dpy, RootWindowOfScreen(scr),
-	    xpos, ypos, width[DST], height[DST], 0,
-	    DefaultDepthOfScreen(scr), InputOutput,
-	    DefaultVisualOfScreen(scr),
-	    CWEventMask | CWBackPixel, &xswa);
-
-	XChangeProperty(dpy, win, XA_WM_ICON_NAME, XA_STRING, 8,
-			PropModeReplace,
-			(unsigned char *)progname, strlen(progname));
-
-	/*
-	XChangeProperty(dpy, win, XA_WM_NAME, XA_STRING, 8,
-			PropModeReplace,
-			(unsigned char *)progname, strlen(progname));
-	*/
-
-
- 	/***	20020213
-		code added by <tmancill@debian.org> to handle
-		window manager "close" event
-	***/
-	wm_delete_window = XInternAtom (dpy, "WM_DELETE_WINDOW", False);
-	wm_protocols = XInternAtom(dpy, "WM_PROTOCOLS", False);
-        status = XSetWMProtocols(dpy, win, &wm_delete_window, 1);
-
-	set_title = True;
-
-	status = XMapWindow(dpy, win);
-
 	gcv.plane_mask = AllPlanes;
 	gcv.subwindow_mode = IncludeInferiors;
 	gcv.function = GXcopy;
@@ -634,10 +3072,7 @@ main(int argc, char **argv) {
 	font = XLoadFont(dpy, "fixed");
 #endif
 
-	resize(width[DST], height[DST]);
-
 #ifdef FRAME
-
 	{
 		static char bitmap_data[] = { 0 };
 		static XColor col = { 0 };
@@ -651,27 +3086,75 @@ main(int argc, char **argv) {
 #endif
 	crosshair = XCreateFontCursor(dpy, XC_crosshair);
 
-	XDefineCursor(dpy, win, crosshair);
+	for(v = views; v < views + nviews; v++) {
+		use_view(v);
+		open_view();
+	}
+
+#ifdef XRENDER
+	if(record_name && use_render) {
+		fprintf(stderr, "%s: -record does not work with -render\n",
+			progname);
+		record_name = NULL;
+	}
+	if(export_name && use_render) {
+		fprintf(stderr, "%s: -export does not work with -render\n",
+			progname);
+		export_name = NULL;
+	}
+#endif
+	if(export_name && server_rows) {
+		fprintf(stderr, "%s: -rows does not work with -export\n",
+			progname);
+		server_rows = False;
+	}
+	if(export_name) {
+		save_view();
+		init_export(views[0].images[1]);
+	}
+
+	init_pointer();
+	init_cursor();
+#ifdef XDAMAGE
+	init_damage();
+	if(guard && damage == None) {
+		fprintf(stderr, "%s: -guard needs XDamage\n", progname);
+		guard = 0;
+	}
+#endif
+	fprintf(stderr, "%s: %s backend\n", progname, backend_name());
+
+	frame_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if(frame_timer < 0) {
+		perror("timerfd_create");
+		exit(-1);
+	}
+#ifdef XSHM
+	if(pipeline)
+		init_capture();
+#endif
+
 
 	for(;;) {
-		if (follow_mouse || show_cursor ) {
-			for (i = 0; i < number_of_screens; i++) {
-				result = XQueryPointer(display, root_windows[i], &window_returned,
-						&window_returned, &root_x, &root_y, &win_x, &win_y,
-						&mask_return);
-				if (result == True) {
-					break;
-				}
-			}
-			if (result != True) {
-				fprintf(stderr, "No mouse found.\n");
-				return -1;
-			}
-			if (follow_mouse) {
-				xgrab = root_x - width[SRC]/2;
-				ygrab = root_y - height[SRC]/2;
-			}
+		/* frames are only due for the pointer when it moved */
+		save_view();
+		polling = pressed = False;
+		for(v = views; v < views + nviews; v++) {
+			polling = polling ||
+				(pointer_moved && (v->follow_mouse || v->show_cursor));
+#ifdef XFIXES
+			polling = polling || (v->show_cursor && cursor_stale);
+#endif
+			pressed = pressed || v->buttonpressed;
 		}
+		wait_for_frame(polling);
+		stats_check();
+
+		/* the frame is erased after each update, keep
+		   updating as fast as we can while it is shown */
+		if(pressed)
+			frame_due = True;
+
 		/*****
 		old event loop updated to support WM messages
 		while(unmapped?
@@ -679,13 +3162,23 @@ main(int argc, char **argv) {
 			XCheckWindowEvent(dpy, win, (long)-1, &event)) {
 		******/
 
+		STAT_START(t);
 		while(XPending(dpy)) {
 			XNextEvent(dpy, &event);
+
+			/* the events of a window are for its view */
+			if(event.type != GenericEvent &&
+			   (v = window_view(event.xany.window)))
+				use_view(v);
+
 			switch(event.type) {
 			case ClientMessage:
                         	if ((event.xclient.message_type == wm_protocols) &&
                                     (event.xclient.data.l[0] == wm_delete_window)) {
-                                	exit(0);
+					/* the other views stay open */
+					close_view();
+					if(nviews == 0)
+						exit(0);
                         	}
                         	break;
 			case ConfigureNotify:
@@ -700,6 +3193,12 @@ main(int argc, char **argv) {
 
 			case MapNotify:
 				unmapped = False;
+				force_update = True;
+				break;
+
+			case Expose:
+			case GraphicsExpose:	/* scroll_window() copied a hidden part */
+				force_update = True;
 				break;
 
 			case UnmapNotify:
@@ -725,8 +3224,8 @@ main(int argc, char **argv) {
 				case '+':
 				case '=':
 				case XK_KP_Add:
-					if(!yzoom_flag) ++magx;
-					if(!xzoom_flag) ++magy;
+					if(!yzoom_flag) zoomx = zoom_step(zoomx, 1);
+					if(!xzoom_flag) zoomy = zoom_step(zoomy, 1);
 					xzoom_flag = yzoom_flag = False;
 					resize(width[DST], height[DST]);
 					set_title = True;
@@ -734,11 +3233,9 @@ main(int argc, char **argv) {
 
 				case '-':
 				case XK_KP_Subtract:
-					if(!yzoom_flag) --magx;
-					if(!xzoom_flag) --magy;
+					if(!yzoom_flag) zoomx = zoom_step(zoomx, -1);
+					if(!xzoom_flag) zoomy = zoom_step(zoomy, -1);
 					xzoom_flag = yzoom_flag = False;
-					if(magx < 1) magx = 1;
-					if(magy < 1) magy = 1;
 					resize(width[DST], height[DST]);
 					set_title = True;
 					break;
@@ -801,11 +3298,13 @@ main(int argc, char **argv) {
 
 				case 'x':
 					flipx = !flipx;
+					select_kernel();
 					set_title = True;
 					break;
 
 				case 'y':
 					flipy = !flipy;
+					select_kernel();
 					set_title = True;
 					break;
 
@@ -834,30 +3333,38 @@ main(int argc, char **argv) {
 					gridy = !gridy;
 					break;
 
+				case 'b':
+					filter = filter == FILTER_NEAREST ?
+						FILTER_BILINEAR : FILTER_NEAREST;
+					select_kernel();
+					break;
+
 				case 'd':
 					if(++delay_index >= NDELAYS)
 						delay_index = 0;
 					delay = delays[delay_index];
-					sprintf(title, "delay = %d ms", delay/1000);
+					if(delay == AUTO_DELAY)
+						sprintf(title, "delay = auto");
+					else
+						sprintf(title, "delay = %d ms", delay/1000);
 					XChangeProperty(dpy, win, XA_WM_NAME, XA_STRING, 8,
 						PropModeReplace,
 						(unsigned char *)title, strlen(title));
-					signal(SIGALRM, timeout_func);
-					alarm(2);
+					title_timeout = now_usec() + TITLE_TIMEOUT;
 					break;
 
 				case 'q':
-					free(root_windows);
-					XCloseDisplay(display);
 					exit(0);
 					break;
 
 				case 'c':
 					show_cursor = ! show_cursor;
+					pointer_moved = pointer_query = True;
 					break;
 
 				case 'f':
 					follow_mouse = ! follow_mouse;
+					pointer_moved = pointer_query = True;
 					break;
 
 				}
@@ -884,6 +3391,11 @@ main(int argc, char **argv) {
 				break;
 
 			case MotionNotify:
+				if(event.xmotion.same_screen) {
+					root_x = event.xmotion.x_root;
+					root_y = event.xmotion.y_root;
+					pointer_moved = True;
+				}
 				if(buttonpressed) {
 #ifdef FRAME
 					xgrab = event.xmotion.x_root - width[SRC]/2;
@@ -895,120 +3407,200 @@ main(int argc, char **argv) {
 				}
 				break;
 
+			default:
+#ifdef XSHM
+				if(use_shm && event.type == shm_completion)
+					shm_completed(&event);
+#endif
+#ifdef XINPUT2
+				if(xi_opcode &&
+				   event.type == GenericEvent &&
+				   event.xcookie.extension == xi_opcode &&
+				   event.xcookie.evtype == XI_RawMotion)
+					pointer_moved = pointer_query = True;
+#endif
+#ifdef XDAMAGE
+				if(damage != None &&
+				   event.type == damage_event_base + XDamageNotify)
+					damage_pending = True;
+#endif
+#ifdef XFIXES
+				if(have_xfixes &&
+				   event.type == xfixes_event_base + XFixesCursorNotify &&
+				   ((XFixesCursorNotifyEvent *)&event)->cursor_serial !=
+				   cursor_serial)
+					cursor_stale = True;
+#endif
+				break;
 			}
 
-			/* trying XShmGetImage when part of the rect is
-			   not on the screen will fail LOUDLY..
-			   we have to veryfy this after anything that may
-			   may modified xgrab or ygrab or the size of
-			   the source ximage */
-
-			if(xgrab < 0)
-				xgrab = 0;
+			clamp_grab();
+		}
+		STAT_STOP(ST_EVENTS, t);
+
+		save_view();
+		following = False;
+		for(v = views; v < views + nviews; v++)
+			following = following || v->follow_mouse || v->show_cursor;
+
+		if (frame_due && following) {
+			if (pointer_query) {
+				STAT_START(t);
+				query_pointer(&root_x, &root_y);
+				STAT_STOP(ST_POINTER, t);
+				pointer_query = False;
+			}
+			pointer_moved = False;
+		}
 
-			if(xgrab > WidthOfScreen(scr)-width[SRC])
-				xgrab =  WidthOfScreen(scr)-width[SRC];
+#ifdef XDAMAGE
+		fetched = False;
+		if(frame_due && damage != None && damage_pending) {
+			damage_pending = False;
+			fetch_damage();
+			fetched = True;
+		}
+#endif
 
-			if(ygrab < 0)
-				ygrab = 0;
+		/* commands which change what we show are done at once.
+		   Otherwise when a frame is due: with XDamage only redraw
+		   when the source area was damaged, without it grab every
+		   time and compare with the last picture */
+		updates = 0;
+		for(v = views; v < views + nviews; v++) {
+			use_view(v);
 
-			if(ygrab > HeightOfScreen(scr)-height[SRC])
-				ygrab = HeightOfScreen(scr)-height[SRC];
+			if (frame_due && follow_mouse) {
+				xgrab = root_x - width[SRC]/2;
+				ygrab = root_y - height[SRC]/2;
+				clamp_grab();
+			}
 
-		}
-#ifdef XSHM
-		XShmGetImage(dpy, RootWindowOfScreen(scr), ximage[SRC],
-			xgrab, ygrab, AllPlanes);
+			moved = !flipxy && (shown.xgrab != xgrab || shown.ygrab != ygrab);
+			if(state_changed())
+				force_update = True;
+			if(cursor_changed(show_cursor, root_x, root_y))
+				cursor_dirty = True;
+
+			if(frame_due) {
+#ifdef XDAMAGE
+				if(damage == None)
+					damaged = True;
+				else if(fetched) {
+					damaged = source_damaged();
+					if(guard)
+						band_damaged(view);
+				}
 #else
-		XGetSubImage(dpy, RootWindowOfScreen(scr),
-			xgrab, ygrab, width[SRC], height[SRC], AllPlanes,
-			ZPixmap, ximage[SRC], 0, 0);
+				damaged = True;
 #endif
+			}
+			if(moved)
+				damaged = True;		/* a new grab, see scroll_window() */
 #ifdef FRAME
-		if(buttonpressed) {	/* show the frame */
-			DRAW_FRAME();
-			XSync(dpy, False);
-		}
+			if(buttonpressed)	/* the frame is erased after each update */
+				force_update = True;
 #endif
 
-
-
-		if (depth == 8)
-			scale8();
-		else if (depth <= 8*sizeof(short))
-			scale16();
-		else if (depth <= 8*sizeof(int))
-			scale32();
-
-		if (show_cursor) {
-			long pixel = 0;
-			int cursor2x = ( root_x - xgrab ) * magx;
-			int cursor2y = ( root_y - ygrab ) * magy;
-
-			if (cursor2x < CURSOR_RADIUS) cursor2x = CURSOR_RADIUS;
-			if (cursor2y < CURSOR_RADIUS) cursor2y = CURSOR_RADIUS;
-
-			if (cursor2x > ximage[DST]->width) cursor2x = ximage[DST]->width - CURSOR_RADIUS;
-			if (cursor2y > ximage[DST]->width) cursor2y = ximage[DST]->height - CURSOR_RADIUS;
-
-			for (int x = cursor2x - CURSOR_RADIUS; x < cursor2x + CURSOR_RADIUS && x < ximage[DST]->width; x++) {
-				for (int y = cursor2y - CURSOR_RADIUS ; y < cursor2y + CURSOR_RADIUS && y < ximage[DST]->height; y++) {
-					// Invert the color of each pixel
-					pixel = XGetPixel(ximage[DST], x, y);
-					XPutPixel(ximage[DST], x, y, ~pixel);
-				}
+#ifdef XSHM
+			if(pipeline) {
+				/* the capture thread grabs while the source changes.
+				   Without a new frame only the cursor can be drawn */
+				if(damaged || force_update)
+					start_capture(force_update);
+				damaged = False;
+				new_frame = take_frame();
+				view->update = new_frame ||
+					(!force_update && cursor_dirty && frame_valid());
 			}
+			else
+#endif
+			view->update = force_update || damaged || cursor_dirty;
+			updates += view->update;
+		}
 
+		if(frame_due) {
+			frame_due = False;
+			next_frame = now_usec() + frame_interval();
 		}
+
+		if(updates) {
+			frame_start = now_usec();
+			frame_start_cpu = cpu_usec();
+			STAT_START(frame_t);
 #ifdef XSHM
-		XShmPutImage(dpy, win, gc, ximage[DST], 0, 0, 0, 0, width[DST], height[DST], False);
-#else
-		XPutImage(dpy, win, gc, ximage[DST], 0, 0, 0, 0, width[DST], height[DST]);
+			if(!pipeline)
 #endif
-		if(set_title) {
-			if(magx == magy && !flipx && !flipy && !flipxy)
-				sprintf(title, "%s x%d", progname, magx);
-			else
-				sprintf(title, "%s X %s%d%s Y %s%d",
-					progname,
-						flipx?"-":"", magx,
-						flipxy?" <=>":";",
-						flipy?"-":"", magy);
-			XChangeProperty(dpy, win, XA_WM_NAME, XA_STRING, 8,
-				PropModeReplace,
-				(unsigned char *)title, strlen(title));
-			set_title = False;
+#ifdef XRENDER
+			if(!use_render)
+#endif
+			grab_views();
 		}
-#ifdef TIMER
-		{
-			struct timeval current_time;
-			double DT;
 
-			gettimeofday(&current_time, NULL);
-			DT = current_time.tv_sec - old_time.tv_sec;
-			DT += 1e-6*(current_time.tv_usec - old_time.tv_usec);
-			sprintf(title, "DT=%6.3f", DT);
-			XDrawString(dpy, win, gc, 20, 20, title, strlen(title));
-			old_time = current_time;
-		}
+		for(v = views; v < views + nviews; v++) {
+			use_view(v);
+			if(view->update)
+				draw_view(root_x, root_y);
+			if(view->update && view == views && record_name)
+				record_frame();
+			if(view->update && view == views && export_name)
+				export_frame();
+#ifdef TIMER
+			if(view->update) {
+				struct timeval current_time;
+				double DT;
+
+				gettimeofday(&current_time, NULL);
+				DT = current_time.tv_sec - old_time.tv_sec;
+				DT += 1e-6*(current_time.tv_usec - old_time.tv_usec);
+				sprintf(title, "DT=%6.3f", DT);
+				XDrawString(dpy, win, gc, 20, 20, title, strlen(title));
+				old_time = current_time;
+			}
 #endif
-		XSync(dpy, 0);
 
-#ifdef NO_USLEEP
-#define usleep(_t)								\
-	{											\
-		struct timeval timeout;					\
-		timeout.tv_sec =  0;					\
-		timeout.tv_usec = _t;					\
-		select(0, NULL, NULL, NULL, &timeout);	\
-	}
+			if(set_title) {
+				if(zoomx == zoomy && !flipx && !flipy && !flipxy)
+					sprintf(title, "%s x%g", progname, zoomx);
+				else
+					sprintf(title, "%s X %s%g%s Y %s%g",
+						progname,
+							flipx?"-":"", zoomx,
+							flipxy?" <=>":";",
+							flipy?"-":"", zoomy);
+				XChangeProperty(dpy, win, XA_WM_NAME, XA_STRING, 8,
+					PropModeReplace,
+					(unsigned char *)title, strlen(title));
+				set_title = False;
+			}
+#ifdef FRAME
+			if(buttonpressed)	/* erase the frame */
+				DRAW_FRAME();
 #endif
+		}
 
-		if(!buttonpressed && delay > 0)
-			usleep(delay);
-#ifdef FRAME
-		if(buttonpressed)	/* erase the frame */
-			DRAW_FRAME();
+		if(!updates)
+			continue;
+
+		/* the grab of the next frame waits for the server anyway,
+		   only the render backend has nothing to wait for */
+		STAT_START(t);
+#ifdef XRENDER
+		if(use_render)
+			XSync(dpy, 0);
+		else
+#endif
+			XFlush(dpy);
+		STAT_STOP(ST_FLUSH, t);
+		STAT_STOP(ST_FRAME, frame_t);
+#ifdef XSHM
+		if(stats_name && new_frame)
+			stat_add(ST_LATENCY,
+				(now_usec() - ring[shown_slot].time) * 1000);
 #endif
+
+		/* keep a running average of what the frames cost */
+		frame_cost += (now_usec() - frame_start - frame_cost) / 8;
+		frame_cpu += (cpu_usec() - frame_start_cpu - frame_cpu) / 8;
 	}
 }
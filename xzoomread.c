@@ -0,0 +1,171 @@
+/* xzoomread - reference reader for xzoom -export.
+
+   Maps the shared memory of xzoom -export name, see export.h, and
+   reads every new frame as it comes: it prints a line about each
+   one, or with -ppm writes them to stdout as a stream of binary PPM
+   images. Stops when xzoom exits, or after -count frames.
+
+   A frame is read in place and only used when its sequence count
+   says xzoom did not write it meanwhile; the PPM conversion goes
+   into a buffer of our own, which is thrown away when that happens. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "export.h"
+
+char *progname;
+
+void
+Usage(void) {
+	fprintf(stderr, "Usage: %s [ args ] name\n"
+		"Command line args:\n"
+		"-ppm             write the frames to stdout as PPM images\n"
+		"-count n         stop after n frames\n"
+		"-interval ms     how often to look for a new frame (5)\n"
+		"name is what was given to xzoom -export.\n",
+		progname);
+	exit(1);
+}
+
+/* the 8 bit value of a channel of pixel p */
+unsigned int
+channel(uint32_t p, uint32_t mask) {
+	if(!mask)
+		return 0;
+	while(!(mask & 1)) {
+		mask >>= 1;
+		p >>= 1;
+	}
+	return (p & mask) * 255 / mask;
+}
+
+/* frame f at p as RGB into out */
+void
+frame_rgb(struct export_header *h, struct export_frame *f,
+		unsigned char *p, unsigned char *out) {
+	int bpp = h->bits_per_pixel / 8;
+	uint32_t pixel;
+	int x, y, k;
+
+	for(y = 0; y < f->height; y++)
+		for(x = 0; x < f->width; x++) {
+			unsigned char *q = p + y * f->bytes_per_line + x * bpp;
+
+			pixel = 0;
+			if(h->byte_order)
+				for(k = 0; k < bpp; k++)
+					pixel = pixel << 8 | q[k];
+			else
+				for(k = bpp - 1; k >= 0; k--)
+					pixel = pixel << 8 | q[k];
+			*out++ = channel(pixel, h->red_mask);
+			*out++ = channel(pixel, h->green_mask);
+			*out++ = channel(pixel, h->blue_mask);
+		}
+}
+
+int
+main(int argc, char **argv) {
+	struct export_header *h;
+	struct export_frame *f, copy;
+	struct stat st;
+	char path[256], *name = NULL;
+	unsigned char *p, *rgb = NULL;
+	uint64_t last = 0, number;
+	uint32_t seq;
+	int fd, k, ppm = 0, count = 0, interval = 5, frames = 0, valid;
+
+	progname = argv[0];
+	while(--argc > 0) {
+		++argv;
+		if(!strcmp(argv[0], "-ppm"))
+			ppm = 1;
+		else if(!strcmp(argv[0], "-count") && argc > 1) {
+			count = atoi(*++argv);
+			argc--;
+		}
+		else if(!strcmp(argv[0], "-interval") && argc > 1) {
+			interval = atoi(*++argv);
+			argc--;
+		}
+		else if(argv[0][0] == '-' || name)
+			Usage();
+		else
+			name = argv[0];
+	}
+	if(!name)
+		Usage();
+
+	snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+	fd = shm_open(path, O_RDONLY, 0);
+	if(fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		exit(1);
+	}
+	h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(h == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+
+	if(st.st_size < sizeof(*h) ||
+	   __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != EXPORT_MAGIC ||
+	   h->version != EXPORT_VERSION || h->nframes != NEXPORT ||
+	   h->frame_offset + NEXPORT * h->frame_size > st.st_size) {
+		fprintf(stderr, "%s: %s is not from xzoom -export\n",
+			progname, path);
+		exit(1);
+	}
+	if(ppm && !(rgb = malloc(h->frame_size / (h->bits_per_pixel / 8) * 3))) {
+		perror("malloc");
+		exit(1);
+	}
+
+	while(!__atomic_load_n(&h->closed, __ATOMIC_ACQUIRE) &&
+	      (count == 0 || frames < count)) {
+		number = __atomic_load_n(&h->number, __ATOMIC_ACQUIRE);
+		if(number == last) {
+			usleep(interval * 1000);
+			continue;
+		}
+
+		k = h->latest;
+		f = &h->frames[k];
+		p = (unsigned char *)h + h->frame_offset + k * h->frame_size;
+
+		seq = export_read_begin(f);
+		copy = *f;
+		valid = copy.width * (h->bits_per_pixel / 8) <= copy.bytes_per_line &&
+			(uint64_t)copy.bytes_per_line * copy.height <= h->frame_size;
+		if(valid && ppm)
+			frame_rgb(h, &copy, p, rgb);
+		if(export_read_retry(f, seq) || !valid)
+			continue;			/* written again meanwhile */
+		last = copy.number > number ? copy.number : number;
+
+		frames++;
+		if(ppm) {
+			printf("P6\n%u %u\n255\n", copy.width, copy.height);
+			fwrite(rgb, 3, copy.width * copy.height, stdout);
+			fflush(stdout);
+			continue;
+		}
+		printf("frame %llu: %ux%u from %ux%u+%d+%d, zoom %gx%g%s%s%s%s\n",
+			(unsigned long long)copy.number, copy.width, copy.height,
+			copy.src_width, copy.src_height, copy.src_x, copy.src_y,
+			copy.zoomx, copy.zoomy,
+			copy.flipx ? ", flipped x" : "",
+			copy.flipy ? ", flipped y" : "",
+			copy.flipxy ? ", rotated" : "",
+			copy.filter ? ", bilinear" : "");
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+/* fractional magnification and the bilinear filter.
+
+   zoomx and zoomy are the magnification, from 1 up. While both are
+   whole numbers and the filter is FILTER_NEAREST scale.h does the
+   work with magx and magy. Otherwise fscale.h does it with the tables
+   zoom_tables() makes whenever the size, zoom or orientation changes.
+
+   DST is still made of blocks, one for each source pixel: column u
+   shows block floor((u + 0.5) / zoomx), so block i starts at column
+   zoom_start(i, zoomx), which is i * magx for whole numbers. Lines
+   the same with zoomy. The bilinear filter looks at (u + 0.5) / zoomx
+   - 0.5 in blocks and mixes the two blocks around it, with a weight
+   in 8 bit fixed point. */
+
+#define FILTER_NEAREST	0
+#define FILTER_BILINEAR	1
+
+#define MAX_ZOOM	32				/* '+' stops here */
+
+double zoomx, zoomy;				/* the magnification */
+int filter = FILTER_NEAREST;
+
+/* '+' and '-' step through these */
+double zoom_steps[] = {
+	1, 1.25, 1.5, 1.75, 2, 2.5, 3, 3.5, 4, 5, 6, 7, 8,
+	10, 12, 14, 16, 20, 24, 28, 32
+};
+#define NZOOMS	(sizeof(zoom_steps) / sizeof(zoom_steps[0]))
+
+int nblock_x, nblock_y;				/* blocks across and down DST */
+int *block_x = NULL;				/* first column of each block, */
+int *block_y = NULL;				/* and line, one more at the end */
+
+/* for column u of DST the offsets in SRC, in pixels, of the block
+   it shows and of the next one, and how much of that one to take.
+   The same for the lines */
+int *col_off0 = NULL, *col_off1 = NULL;
+unsigned char *col_w = NULL;
+int *line_off0 = NULL, *line_off1 = NULL;
+unsigned char *line_w = NULL;
+int tables_bpl;						/* bytes_per_line of SRC they are for */
+
+/* for the bilinear filter two lines of DST for each thread, the
+   source lines are mixed across into them, see fscale.h. Thread n
+   has those at blend_rows + 2 * n * blend_row_size */
+int blend_threads = 1;				/* set by init_workers() */
+unsigned char *blend_rows = NULL;
+int blend_row_size;					/* bytes of one line */
+__thread int blend_thread;			/* which of them this thread uses */
+
+/* mask of the 16 bit pixel spread over 32 bits, see blend16() */
+unsigned int blend16_mask = 0x07e0f81f;	/* 5-6-5, 0x03e07c1f for 5-5-5 */
+
+/* the first pixel of block i, also the size of i blocks */
+int
+zoom_start(int i, double z) {
+	return (int)ceil(i * z - 0.5);
+}
+
+/* the next zoom from z up (dir > 0) or down */
+double
+zoom_step(double z, int dir) {
+	int k;
+
+	if(dir > 0) {
+		for(k = 0; k < NZOOMS; k++)
+			if(zoom_steps[k] > z)
+				return zoom_steps[k];
+		return z;
+	}
+
+	for(k = NZOOMS - 1; k >= 0; k--)
+		if(zoom_steps[k] < z)
+			return zoom_steps[k];
+	return z;
+}
+
+/* w / 256 of b and the rest of a, for each byte of a 32 bit pixel */
+static inline unsigned int
+blend32(unsigned int a, unsigned int b, int w) {
+	unsigned int rb, ag;
+
+	rb = ((a & 0xff00ff) * (256 - w) + (b & 0xff00ff) * w) >> 8;
+	ag = ((a >> 8 & 0xff00ff) * (256 - w) + (b >> 8 & 0xff00ff) * w);
+	return (rb & 0xff00ff) | (ag & 0xff00ff00);
+}
+
+/* the same for 16 bit pixels: the channels are spread over 32 bits
+   with room between them and mixed at once with 5 bit weights */
+static inline unsigned short
+blend16(unsigned short a, unsigned short b, int w) {
+	unsigned int x = (a | (unsigned int)a << 16) & blend16_mask;
+	unsigned int y = (b | (unsigned int)b << 16) & blend16_mask;
+
+	w >>= 3;
+	x = ((x * (32 - w) + y * w) >> 5) & blend16_mask;
+	return x | x >> 16;
+}
+
+/* blend16() for pixels in the other byte order. blend32() mixes
+   each byte on its own, so it works for those as they are */
+static inline unsigned short
+blend16_swapped(unsigned short a, unsigned short b, int w) {
+	return __builtin_bswap16(blend16(__builtin_bswap16(a),
+		__builtin_bswap16(b), w));
+}
+
+/* the tables for one axis: n blocks at zoom z, the offset in SRC of
+   block i is base + i * step. Makes start[n + 1] and the offsets
+   and weights of the zoom_start(n, z) pixels */
+void
+axis_tables(int n, double z, int base, int step, int **start,
+		int **off0, int **off1, unsigned char **w) {
+	int size = zoom_start(n, z);
+	int i, u;
+	double pos;
+
+	*start = realloc(*start, (n + 1) * sizeof(int));
+	*off0 = realloc(*off0, size * sizeof(int));
+	*off1 = realloc(*off1, size * sizeof(int));
+	*w = realloc(*w, size);
+
+	for(i = 0; i <= n; i++)
+		(*start)[i] = zoom_start(i, z);
+
+	for(i = 0; i < n; i++)
+		for(u = (*start)[i]; u < (*start)[i + 1]; u++) {
+			if(filter == FILTER_NEAREST) {
+				(*off0)[u] = (*off1)[u] = base + i * step;
+				(*w)[u] = 0;
+				continue;
+			}
+
+			/* the block on the left and how far right of it we are */
+			pos = (u + 0.5) / z - 0.5;
+			if(pos < 0)
+				pos = 0;
+			if(pos > n - 1)
+				pos = n - 1;
+			(*off0)[u] = base + (int)pos * step;
+			(*w)[u] = (pos - (int)pos) * 256;
+			(*off1)[u] = (*w)[u] ? (*off0)[u] + step : (*off0)[u];
+		}
+}
+
+/* make the tables for the current size, zoom and orientation.
+   The offsets are in pixels, for packed 24 bit pixels in bytes */
+void
+zoom_tables(void) {
+	int bpp = ximage[SRC]->bits_per_pixel;
+	int px = bpp == 24 ? 3 : 1;			/* one pixel across */
+	int e = bpp == 24 ? ximage[SRC]->bytes_per_line :
+		ximage[SRC]->bytes_per_line * 8 / bpp;	/* one line down */
+
+	tables_bpl = ximage[SRC]->bytes_per_line;
+	if(flipxy) {
+		nblock_x = height[SRC];
+		nblock_y = width[SRC];
+		/* columns go down SRC, lines go left */
+		axis_tables(nblock_x, zoomx,
+			flipx ? (height[SRC] - 1) * e : 0, flipx ? -e : e,
+			&block_x, &col_off0, &col_off1, &col_w);
+		axis_tables(nblock_y, zoomy,
+			flipy ? 0 : (width[SRC] - 1) * px, flipy ? px : -px,
+			&block_y, &line_off0, &line_off1, &line_w);
+	}
+	else {
+		nblock_x = width[SRC];
+		nblock_y = height[SRC];
+		axis_tables(nblock_x, zoomx,
+			flipx ? (width[SRC] - 1) * px : 0, flipx ? -px : px,
+			&block_x, &col_off0, &col_off1, &col_w);
+		axis_tables(nblock_y, zoomy,
+			flipy ? (height[SRC] - 1) * e : 0, flipy ? -e : e,
+			&block_y, &line_off0, &line_off1, &line_w);
+	}
+
+	if(filter == FILTER_BILINEAR) {
+		/* a cache line apart, so the threads do not share one */
+		blend_row_size = (block_x[nblock_x] * bpp / 8 + 63) & ~63;
+		blend_rows = realloc(blend_rows,
+			2 * blend_threads * blend_row_size);
+		if(!blend_rows) {
+			perror("realloc");
+			exit(-1);
+		}
+	}
+}